@@ -0,0 +1,78 @@
+/*
+ * baud.c
+ *
+ * Baud rate negotiation, see baud.h for the exchange.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "baud.h"
+#include "serialio.h"
+#include "timer0.h"
+
+int16_t baud_error(uint32_t baudrate) {
+	// UBRR0 is 12 bits
+	if (baudrate == 0 || baudrate > SERIAL_CLOCK / 8
+			|| SERIAL_UBRR(baudrate) > 4095) {
+		return BAUD_OUT_OF_RANGE;
+	}
+	uint32_t actual = SERIAL_CLOCK / 8 / (SERIAL_UBRR(baudrate) + 1);
+	return ((int32_t)actual - (int32_t)baudrate) * 1000 / (int32_t)baudrate;
+}
+
+uint8_t baud_supported(uint32_t baudrate) {
+	int16_t error = baud_error(baudrate);
+	return error >= -BAUD_MAX_ERROR && error <= BAUD_MAX_ERROR;
+}
+
+// read a line (up to the CR, which arrives as \n) into 'line' without
+// it. Returns 0 if it doesn't all arrive before 'deadline' or is too long.
+static uint8_t read_line(char *line, uint8_t size, uint32_t deadline) {
+	uint8_t length = 0;
+	while (get_current_time() < deadline) {
+		if (!serial_input_available()) {
+			continue;
+		}
+		char c = fgetc(stdin);
+		if (c == '\n') {
+			line[length] = 0;
+			return 1;
+		}
+		if (length == size - 1) {
+			return 0;
+		}
+		line[length++] = c;
+	}
+	return 0;
+}
+
+uint8_t negotiate_baud(void) {
+	char line[12];
+
+	if (!read_line(line, sizeof(line), get_current_time() + BAUD_REQUEST_MS)
+			|| line[0] != 'B') {
+		return 0;
+	}
+	uint32_t baudrate = strtoul(line + 1, NULL, 10);
+	if (!baud_supported(baudrate)) {
+		printf_P(PSTR("\x16" "NAK\n"));
+		return 0;
+	}
+	printf_P(PSTR("\x16" "ACK %lu\n"), (unsigned long)baudrate);
+
+	uint32_t old_baudrate = serial_get_baud();
+	serial_set_baud(baudrate);
+	// anything which arrived while the rates didn't match is rubbish
+	clear_serial_input_buffer();
+	if (read_line(line, sizeof(line), get_current_time() + BAUD_CONFIRM_MS)
+			&& line[0] == BAUD_SYN && strcmp_P(line + 1, PSTR("OK")) == 0) {
+		printf_P(PSTR("\x16" "OK\n"));
+		return 1;
+	}
+	serial_set_baud(old_baudrate);
+	return 0;
+}
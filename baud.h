@@ -0,0 +1,51 @@
+/*
+ * baud.h
+ *
+ * Lets the computer at the other end of the serial port move the board
+ * to a faster baud rate. The board always starts at 19200 baud, which
+ * any terminal can use, and the computer asks for a faster rate (the
+ * tools/serial_speed.py script does this):
+ *
+ *   computer: SYN "B<rate>" CR         e.g. "\x16B1000000\r"
+ *   board:    SYN "ACK <rate>" CR LF   (or SYN "NAK" CR LF if the rate
+ *                                       can't be made from the clock)
+ *   both change to the new rate
+ *   computer: SYN "OK" CR
+ *   board:    SYN "OK" CR LF
+ *
+ * If the board doesn't get the OK within BAUD_CONFIRM_MS of changing, it
+ * goes back to the rate it was using before.
+ */
+
+#ifndef BAUD_H_
+#define BAUD_H_
+
+#include <stdint.h>
+
+// the character which starts a request
+#define BAUD_SYN 0x16
+
+// a rate is only used if the one the clock gives is within this many
+// tenths of a percent of it
+#define BAUD_MAX_ERROR 20
+
+// how long the rest of a request, and the OK at the new rate, may take
+// to arrive (milliseconds)
+#define BAUD_REQUEST_MS 200
+#define BAUD_CONFIRM_MS 1000
+
+// returned by baud_error() for a rate UBRR0 can't be set for
+#define BAUD_OUT_OF_RANGE 0x7FFF
+
+// the error of the rate the clock gives for 'baudrate', in tenths of a
+// percent (positive if it is too fast)
+int16_t baud_error(uint32_t baudrate);
+
+// check whether 'baudrate' can be used
+uint8_t baud_supported(uint32_t baudrate);
+
+// deal with a request for a new rate, call this when BAUD_SYN has been
+// read. Returns 1 if the rate was changed, 0 if not.
+uint8_t negotiate_baud(void);
+
+#endif /* BAUD_H_ */
@@ -0,0 +1,413 @@
+/*
+ * bench.c
+ *
+ * Benchmarks for the computer player.
+ *
+ * The perft benchmark counts the positions at the end of every line of
+ * play up to a given number of moves from the start of the game (a pass
+ * counts as a move, and a game which ends sooner counts once). Every
+ * position is made with make_move() and unmade again, so it measures
+ * move generation and flipping together. The counts are checked against
+ * the published numbers for Reversi.
+ *
+ * The endgame positions were reached by the computer playing itself
+ * from a few random opening moves, and their scores were worked out
+ * beforehand (checked against a plain minimax search for up to 16 empty
+ * squares). Positions are solved exactly when they have no more than
+ * ENDGAME_EMPTIES empty squares and for win/loss/draw when they have no
+ * more than ENDGAME_WLD_EMPTIES, the larger ones are skipped. With the
+ * default thresholds the AVR runs the positions up to 14 empty squares,
+ * other builds run them all.
+ *
+ * The transposition table benchmark searches a few positions from the
+ * first part of the game to a fixed depth, once with the table and once
+ * without it, and prints how many fewer nodes were visited with it. The
+ * positions are reached by playing the first legal move (the lowest
+ * square) for a given number of moves from the start.
+ *
+ * The render benchmark draws every board square over and over, in an
+ * order which mixes short and long cursor moves, and counts the cycles
+ * spent in update_square_colour(). It waits for the serial port to have
+ * room before each square, outside the timing, so only the work of
+ * producing the bytes is counted.
+ *
+ * The serial benchmark lists the baud rates the clock can make (see
+ * baud.h) and then times sending a block of text at the current rate,
+ * from the first byte being queued until the last has left the UART.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "bench.h"
+#include "baud.h"
+#include "display.h"
+#include "endgame.h"
+#include "game.h"
+#include "search.h"
+#include "serialio.h"
+#include "terminalio.h"
+#include "timer0.h"
+#include "timer1.h"
+#include "ttable.h"
+
+// perft is run from depth 1 up to this depth
+#ifndef PERFT_DEPTH
+#ifdef __AVR__
+#define PERFT_DEPTH 6
+#else
+#define PERFT_DEPTH 10
+#endif
+#endif
+
+// the number of positions at each depth from the start, depth 1 first
+static const uint32_t perft_counts[] PROGMEM = {
+	4, 12, 56, 244, 1396, 8200, 55092, 390216, 3005288, 24571284,
+	212258800, 1939886636
+};
+
+#define MAX_PERFT_DEPTH (sizeof(perft_counts) / sizeof(perft_counts[0]))
+
+// positions made by perft(), including those short of the full depth
+static uint32_t perft_nodes;
+
+// no position is given longer than this to solve (milliseconds)
+#define BENCH_TIME_BUDGET 60000
+
+// the depth the transposition table benchmark searches to
+#ifndef TT_BENCH_DEPTH
+#ifdef __AVR__
+#define TT_BENCH_DEPTH 4
+#else
+#define TT_BENCH_DEPTH 8
+#endif
+#endif
+
+// the moves from the start of the game to each position it searches
+static const uint8_t tt_bench_plies[] PROGMEM = { 0, 6, 12, 18, 24 };
+
+#define NUM_TT_BENCH_POSITIONS (sizeof(tt_bench_plies) / sizeof(tt_bench_plies[0]))
+
+// squares drawn by the render benchmark (a multiple of 64, so each
+// square is drawn the same number of times)
+#define RENDER_BENCH_SQUARES 1024
+
+// room in the serial output buffer to wait for before timing a square
+#define RENDER_BENCH_TX_FREE 32
+
+// the rates listed by the serial benchmark
+static const uint32_t bench_baudrates[] PROGMEM = {
+	9600, 19200, 38400, 57600, 76800, 115200, 230400, 250000, 500000, 1000000
+};
+
+#define NUM_BENCH_BAUDRATES (sizeof(bench_baudrates) / sizeof(bench_baudrates[0]))
+
+#ifdef __AVR__
+// the line sent over and over by the serial benchmark (64 bytes)
+static const char serial_bench_line[] PROGMEM =
+	"0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz\r\n";
+
+#define SERIAL_BENCH_LINES 128
+#endif
+
+typedef struct {
+	bitboard_t pieces[2];	// as in position_t
+	uint8_t side;			// the player to move
+	uint8_t empties;
+	int8_t score;			// final disc difference with best play, for side
+} endgame_test_t;
+
+static const endgame_test_t endgame_tests[] PROGMEM = {
+	{{0x140C746F4F047CFCULL, 0xE0D08B90B0FB8000ULL}, 0, 10, -16},
+	{{0xFCFCADC0E8200080ULL, 0x0001523C17DEFC7CULL}, 0, 10, +34},
+	{{0x2C9CFCF0E4CC1C3EULL, 0x0103030F1B336140ULL}, 0, 10, -42},
+	{{0xFE1C0C4257647CFCULL, 0x00A0F2BDA8988000ULL}, 1, 11, -16},
+	{{0x7CECD4C8B4BCB8E0ULL, 0x80112B374B434000ULL}, 1, 11, +16},
+	{{0x0E000840404E44FEULL, 0xF0FCF6BCBCB0B800ULL}, 0, 12, -24},
+	{{0x00181627172710FEULL, 0x3EE4E8D8E8D82800ULL}, 0, 12, +22},
+	{{0xC0D0D0C0E2E0C0FEULL, 0x00042F3F1D1F3D00ULL}, 0, 12, +44},
+	{{0x1E3CE492A68684A4ULL, 0x00011B6D59793818ULL}, 1, 13, +12},
+	{{0x02000C7C5C7C4000ULL, 0x3DBFF383A3838303ULL}, 1, 13, +30},
+	{{0x00021E0E506E7CFCULL, 0xE0E1E1F1AE908000ULL}, 0, 14, -24},
+	{{0x0038342E0E0C3038ULL, 0x3E04CBD1F1F3C480ULL}, 0, 14, -40},
+	{{0x809098C0E2E0C0FEULL, 0x0040673F1D1F3D00ULL}, 0, 14, +44},
+	{{0x008CFBE9BCEE1000ULL, 0x0010041643112D7FULL}, 0, 16, -32},
+	{{0x003830284A6C3038ULL, 0x3E04CFD5B5938480ULL}, 0, 16, -24},
+	{{0x0000840A2430383EULL, 0x1E1D3BF5DB4F0500ULL}, 0, 16, +22},
+	{{0x844C341058C00000ULL, 0x0000CBEF273F3C7EULL}, 0, 18, +8},
+	{{0x8484809484D40800ULL, 0x10387F6B7B2B140EULL}, 0, 18, +38},
+	{{0x002027270F212921ULL, 0x081898D8705E141EULL}, 0, 20, +12},
+	{{0x0808103200D82C00ULL, 0x00312D8D7F27113EULL}, 0, 22, -6}
+};
+
+#define NUM_ENDGAME_TESTS (sizeof(endgame_tests) / sizeof(endgame_tests[0]))
+
+static uint32_t perft(position_t *pos, uint8_t depth) {
+	if (depth == 0) {
+		return 1;
+	}
+	bitboard_t moves = legal_moves(pos);
+	uint32_t count = 0;
+	if (!moves) {
+		if (position_game_over(pos)) {
+			return 1;
+		}
+		undo_t undo = make_move(pos, PASS_MOVE);
+		perft_nodes++;
+		count = perft(pos, depth - 1);
+		unmake_move(pos, &undo);
+		return count;
+	}
+	while (moves) {
+		uint8_t sq = (uint8_t)__builtin_ctzll(moves);
+		moves &= moves - 1;
+		undo_t undo = make_move(pos, sq);
+		perft_nodes++;
+		count += perft(pos, depth - 1);
+		unmake_move(pos, &undo);
+	}
+	return count;
+}
+
+void run_perft_benchmark(void) {
+	uint8_t failed = 0;
+	position_t pos;
+	init_position(&pos);
+
+	printf_P(PSTR("Perft benchmark\n"));
+	for (uint8_t depth = 1; depth <= PERFT_DEPTH && depth <= MAX_PERFT_DEPTH; depth++) {
+		perft_nodes = 0;
+		uint32_t start_time = get_current_time();
+		uint32_t start_cycles = get_cycle_count();
+		uint32_t count = perft(&pos, depth);
+		uint32_t cycles = get_cycle_count() - start_cycles;
+		uint32_t time_ms = get_current_time() - start_time;
+		uint32_t expected = pgm_read_dword(&perft_counts[depth - 1]);
+		if (count != expected) {
+			failed++;
+		}
+
+		printf_P(PSTR("depth %2u: %10lu positions (expected %10lu), %10lu made, %6lu ms"),
+				(unsigned)depth, (unsigned long)count, (unsigned long)expected,
+				(unsigned long)perft_nodes, (unsigned long)time_ms);
+		if (time_ms) {
+			printf_P(PSTR(", %8lu made/s"), (unsigned long)(perft_nodes / time_ms * 1000
+					+ perft_nodes % time_ms * 1000 / time_ms));
+		}
+#ifdef __AVR__
+		// the cycle counter wraps after about 268 seconds
+		if (time_ms < 250000UL) {
+			printf_P(PSTR(", %lu cycles/move"), (unsigned long)(cycles / perft_nodes));
+		}
+#else
+		(void)cycles;
+#endif
+		printf_P(count == expected ? PSTR(" ok\n") : PSTR(" WRONG\n"));
+	}
+	printf_P(PSTR("%u wrong\n"), (unsigned)failed);
+}
+
+static inline int8_t sign_of(int8_t score) {
+	return (score > 0) - (score < 0);
+}
+
+void run_endgame_benchmark(void) {
+	uint32_t total_nodes = 0;
+	uint32_t total_ms = 0;
+	uint8_t passed = 0;
+	uint8_t failed = 0;
+
+	printf_P(PSTR("Endgame benchmark (exact up to %u empties, WLD up to %u)\n"),
+			(unsigned)ENDGAME_EMPTIES, (unsigned)ENDGAME_WLD_EMPTIES);
+	for (uint8_t i = 0; i < NUM_ENDGAME_TESTS; i++) {
+		endgame_test_t test;
+		memcpy_P(&test, &endgame_tests[i], sizeof(test));
+		if (test.empties > ENDGAME_WLD_EMPTIES) {
+			continue;
+		}
+
+		position_t pos;
+		pos.pieces[0] = test.pieces[0];
+		pos.pieces[1] = test.pieces[1];
+		pos.side = test.side;
+		pos.hash = compute_hash(&pos);
+
+		uint8_t mode = (test.empties <= ENDGAME_EMPTIES) ? ENDGAME_EXACT : ENDGAME_WLD;
+		int8_t expected = (mode == ENDGAME_EXACT) ? test.score : sign_of(test.score);
+		endgame_result_t result = solve_endgame(&pos, mode, BENCH_TIME_BUDGET);
+		uint8_t ok = result.solved && result.score == expected;
+		if (ok) {
+			passed++;
+		} else {
+			failed++;
+		}
+		total_nodes += result.nodes;
+		total_ms += result.time_ms;
+
+		printf_P(PSTR("%2u: %2u empties, expected %+3d got %+3d, %9lu nodes %6lu ms "),
+				(unsigned)i, (unsigned)test.empties, expected, result.score,
+				(unsigned long)result.nodes, (unsigned long)result.time_ms);
+		if (mode == ENDGAME_WLD) {
+			printf_P(PSTR("(WLD) "));
+		}
+		if (!result.solved) {
+			printf_P(PSTR("timed out\n"));
+		} else if (ok) {
+			printf_P(PSTR("ok\n"));
+		} else {
+			printf_P(PSTR("WRONG\n"));
+		}
+	}
+
+	printf_P(PSTR("%u ok, %u failed, %lu nodes in %lu ms"),
+			(unsigned)passed, (unsigned)failed, (unsigned long)total_nodes,
+			(unsigned long)total_ms);
+	if (total_ms) {
+		printf_P(PSTR(", %lu nodes/s"), (unsigned long)(total_nodes / total_ms * 1000
+				+ total_nodes % total_ms * 1000 / total_ms));
+	}
+	printf_P(PSTR("\n"));
+}
+
+// search pos to TT_BENCH_DEPTH with the transposition table on or off,
+// starting from an empty table each time
+static search_result_t tt_bench_search(position_t *pos, uint8_t enabled) {
+	search_new_game();
+	tt_set_enabled(enabled);
+	search_result_t result = search_best_move(pos, BENCH_TIME_BUDGET);
+	tt_set_enabled(1);
+	return result;
+}
+
+void run_tt_benchmark(void) {
+	uint32_t total_with = 0;
+	uint32_t total_without = 0;
+
+	printf_P(PSTR("Transposition table benchmark (depth %u, %u entries)\n"),
+			(unsigned)TT_BENCH_DEPTH, (unsigned)TT_ENTRIES);
+	search_set_depth_limit(TT_BENCH_DEPTH);
+	for (uint8_t i = 0; i < NUM_TT_BENCH_POSITIONS; i++) {
+		position_t pos;
+		init_position(&pos);
+		uint8_t plies = pgm_read_byte(&tt_bench_plies[i]);
+		for (uint8_t ply = 0; ply < plies && !position_game_over(&pos); ply++) {
+			bitboard_t moves = legal_moves(&pos);
+			apply_move(&pos, (uint8_t)__builtin_ctzll(moves));
+		}
+
+		search_result_t with = tt_bench_search(&pos, 1);
+		search_result_t without = tt_bench_search(&pos, 0);
+		printf_P(PSTR("%2u moves: %9lu nodes %6lu ms with, %9lu nodes %6lu ms without"),
+				(unsigned)plies, (unsigned long)with.nodes, (unsigned long)with.time_ms,
+				(unsigned long)without.nodes, (unsigned long)without.time_ms);
+		if (with.depth != TT_BENCH_DEPTH || without.depth != TT_BENCH_DEPTH) {
+			// a search which stopped early doesn't compare
+			printf_P(PSTR(", depth %u/%u\n"), (unsigned)with.depth,
+					(unsigned)without.depth);
+			continue;
+		}
+		total_with += with.nodes;
+		total_without += without.nodes;
+		if (without.nodes) {
+			printf_P(PSTR(", %ld%% fewer\n"), (long)(100 - (int64_t)with.nodes * 100
+					/ without.nodes));
+		} else {
+			printf_P(PSTR("\n"));
+		}
+	}
+	search_set_depth_limit(0);
+
+	printf_P(PSTR("%lu nodes with the table, %lu without"),
+			(unsigned long)total_with, (unsigned long)total_without);
+	if (total_without) {
+		printf_P(PSTR(", %ld%% fewer"), (long)(100 - (int64_t)total_with * 100
+				/ total_without));
+	}
+	printf_P(PSTR("\n"));
+}
+
+void run_render_benchmark(void) {
+	uint32_t total_cycles = 0;
+
+	// the cost of reading the cycle counter, taken off the total
+	uint32_t start_cycles;
+	uint32_t overhead = 0;
+	for (uint16_t i = 0; i < RENDER_BENCH_SQUARES; i++) {
+		start_cycles = get_cycle_count();
+		overhead += get_cycle_count() - start_cycles;
+	}
+
+	initialise_display();
+	for (uint8_t line = 0; line < BOARD_LINES; line++) {
+		draw_board_line(line);
+	}
+	uint32_t start_bytes = serial_bytes_sent();
+	for (uint16_t i = 0; i < RENDER_BENCH_SQUARES; i++) {
+		// 7 has no factor in common with 64, so every square is visited
+		// once in each 64, and it changes colour from one visit to the next
+		uint8_t sq = (i * 7) % (WIDTH * HEIGHT);
+		uint8_t object = ((i / (WIDTH * HEIGHT)) & 1) ? PLAYER_2 : PLAYER_1;
+		while (serial_tx_free() < RENDER_BENCH_TX_FREE) {
+			; // wait for the serial port
+		}
+		start_cycles = get_cycle_count();
+		update_square_colour(sq % WIDTH, sq / WIDTH, object);
+		total_cycles += get_cycle_count() - start_cycles;
+	}
+	total_cycles = (total_cycles > overhead) ? total_cycles - overhead : 0;
+	uint32_t bytes = serial_bytes_sent() - start_bytes;
+	normal_display_mode();
+	clear_terminal();
+	move_terminal_cursor(1, 1);
+
+	printf_P(PSTR("Render benchmark\n%u squares drawn, %lu.%02lu cycles per square, %lu.%02lu bytes per square\n"),
+			(unsigned)RENDER_BENCH_SQUARES,
+			(unsigned long)(total_cycles / RENDER_BENCH_SQUARES),
+			(unsigned long)(total_cycles % RENDER_BENCH_SQUARES * 100 / RENDER_BENCH_SQUARES),
+			(unsigned long)(bytes / RENDER_BENCH_SQUARES),
+			(unsigned long)(bytes % RENDER_BENCH_SQUARES * 100 / RENDER_BENCH_SQUARES));
+}
+
+void run_serial_benchmark(void) {
+	printf_P(PSTR("Serial benchmark\n    Baud  UBRR   Actual  Error\n"));
+	for (uint8_t i = 0; i < NUM_BENCH_BAUDRATES; i++) {
+		uint32_t baudrate = pgm_read_dword(&bench_baudrates[i]);
+		int16_t error = baud_error(baudrate);
+		// the error is shown in percent with one decimal
+		uint16_t size = (error < 0) ? -error : error;
+		printf_P(PSTR("%8lu  %4u  %7lu  %c%u.%u%%  %s\n"),
+				(unsigned long)baudrate, (unsigned)SERIAL_UBRR(baudrate),
+				(unsigned long)(SERIAL_CLOCK / 8 / (SERIAL_UBRR(baudrate) + 1)),
+				(error < 0) ? '-' : '+', size / 10, size % 10,
+				baud_supported(baudrate) ? "ok" : "no");
+	}
+
+#ifdef __AVR__
+	// time the block from when it starts to be sent until the last byte
+	// has gone
+	uint16_t length = strlen_P(serial_bench_line);
+	serial_flush();
+	uint32_t start_time = get_current_time();
+	for (uint8_t line = 0; line < SERIAL_BENCH_LINES; line++) {
+		serial_write_P(serial_bench_line, length);
+	}
+	serial_flush();
+	uint32_t ms = get_current_time() - start_time;
+	if (ms == 0) {
+		ms = 1;
+	}
+
+	uint32_t bytes = (uint32_t)length * SERIAL_BENCH_LINES;
+	uint32_t rate = bytes * 1000 / ms;
+	// a byte takes 10 bits (start, 8 data, stop)
+	uint32_t baudrate = serial_get_baud();
+	printf_P(PSTR("%lu bytes in %lu ms at %lu baud: %lu bytes/s, %lu%% of the line rate\n"),
+			(unsigned long)bytes, (unsigned long)ms, (unsigned long)baudrate,
+			(unsigned long)rate, (unsigned long)((uint64_t)rate * 1000 / baudrate));
+#else
+	// the host's terminal has no line rate to measure
+	printf_P(PSTR("(the line rate can only be measured on the board)\n"));
+#endif
+}
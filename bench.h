@@ -0,0 +1,34 @@
+/*
+ * bench.h
+ *
+ * Benchmarks for the computer player, run from the start screen. The
+ * results are printed to the serial terminal.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+// count the positions reached by every line of play from the start of
+// the game, one depth after another, checking the counts and printing
+// how fast the moves were made
+void run_perft_benchmark(void);
+
+// solve a fixed set of endgame positions and check the results against
+// the known scores, printing the nodes and time taken by each
+void run_endgame_benchmark(void);
+
+// search a few positions to a fixed depth with and without the
+// transposition table and print the nodes each visited
+void run_tt_benchmark(void);
+
+// draw board squares on the terminal and print how many cycles each one
+// took, not counting any wait for the serial port (the terminal is
+// cleared afterwards)
+void run_render_benchmark(void);
+
+// list the baud rates which can be used and how far each is off, then
+// time sending a block of text at the current rate and print the bytes
+// per second which got through
+void run_serial_benchmark(void);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,146 @@
+/*
+ * book.c
+ *
+ * Opening book for the computer player.
+ *
+ * The book is stored in flash as a trie written out in preorder, one byte
+ * per move: the square in the low 6 bits, BOOK_LAST_SIBLING set on the
+ * last reply in each list and BOOK_HAS_REPLIES set when the replies to
+ * the move follow straight after it. Lines are only stored in one of the
+ * orientations of the board which leave the starting position unchanged,
+ * so the game's moves are turned into each of these orientations in turn
+ * while looking them up.
+ */
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "book.h"
+#include "game.h"
+#include "timer1.h"
+
+#define BOOK_SQUARE_MASK	0x3F
+#define BOOK_LAST_SIBLING	0x40
+#define BOOK_HAS_REPLIES	0x80
+
+// the symmetries which map the starting position onto itself, see
+// transform_square() for how they are numbered
+#define NUM_BOOK_SYMMETRIES 4
+static const uint8_t book_symmetries[NUM_BOOK_SYMMETRIES] PROGMEM = { 0, 3, 4, 7 };
+
+static book_stats_t stats;
+
+// apply a symmetry of the board to a square. Bit 0 of the symmetry
+// mirrors x, bit 1 mirrors y and bit 2 then swaps x and y
+static uint8_t transform_square(uint8_t sq, uint8_t symmetry) {
+	uint8_t x = SQUARE_X(sq);
+	uint8_t y = SQUARE_Y(sq);
+	if (symmetry & 1) {
+		x = 7 - x;
+	}
+	if (symmetry & 2) {
+		y = 7 - y;
+	}
+	if (symmetry & 4) {
+		uint8_t swap = x;
+		x = y;
+		y = swap;
+	}
+	return SQUARE(x, y);
+}
+
+// the symmetry which undoes the given one. Swapping x and y after the
+// mirrors is the same as swapping them before mirroring the other way
+static uint8_t inverse_symmetry(uint8_t symmetry) {
+	if (symmetry & 4) {
+		return 4 | ((symmetry & 1) << 1) | ((symmetry >> 1) & 1);
+	}
+	return symmetry;
+}
+
+// returns the position of the next byte after the move at pos and all
+// of the replies below it
+static uint16_t skip_move(uint16_t pos) {
+	uint8_t node = pgm_read_byte(&opening_book[pos++]);
+	if (!(node & BOOK_HAS_REPLIES)) {
+		return pos;
+	}
+	// depth counts the lists of replies we are inside, bit i of
+	// last_moves records if the move owning the list at depth i+2 was
+	// the last in its own list (so that list ends along with it)
+	uint8_t depth = 1;
+	uint16_t last_moves = 0;
+	while (depth) {
+		node = pgm_read_byte(&opening_book[pos++]);
+		if (node & BOOK_HAS_REPLIES) {
+			last_moves = (last_moves << 1) | ((node & BOOK_LAST_SIBLING) ? 1 : 0);
+			depth++;
+		} else if (node & BOOK_LAST_SIBLING) {
+			// this list has ended, and so has every enclosing list
+			// whose owner was also last in its list
+			while (--depth) {
+				uint8_t owner_was_last = last_moves & 1;
+				last_moves >>= 1;
+				if (!owner_was_last) {
+					break;
+				}
+			}
+		}
+	}
+	return pos;
+}
+
+// look up the moves with the book in one orientation
+static uint8_t lookup_oriented(const uint8_t *moves, uint8_t count,
+		uint8_t symmetry) {
+	uint16_t pos = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		if (moves[i] >= PASS_MOVE) {
+			return NO_BOOK_MOVE;
+		}
+		uint8_t wanted = transform_square(moves[i], symmetry);
+
+		// find the move among the replies at this point
+		uint8_t node;
+		while (1) {
+			node = pgm_read_byte(&opening_book[pos]);
+			if ((node & BOOK_SQUARE_MASK) == wanted) {
+				break;
+			}
+			if (node & BOOK_LAST_SIBLING) {
+				return NO_BOOK_MOVE;
+			}
+			pos = skip_move(pos);
+		}
+		if (!(node & BOOK_HAS_REPLIES)) {
+			// the book line ends here
+			return NO_BOOK_MOVE;
+		}
+		pos++;
+	}
+	// the first reply is the preferred one
+	uint8_t reply = pgm_read_byte(&opening_book[pos]) & BOOK_SQUARE_MASK;
+	return transform_square(reply, inverse_symmetry(symmetry));
+}
+
+uint8_t book_lookup(const uint8_t *moves, uint8_t count) {
+	uint32_t start = get_cycle_count();
+	uint8_t move = NO_BOOK_MOVE;
+	if (count < BOOK_MAX_PLY) {
+		for (uint8_t i = 0; i < NUM_BOOK_SYMMETRIES && move == NO_BOOK_MOVE; i++) {
+			move = lookup_oriented(moves, count, pgm_read_byte(&book_symmetries[i]));
+		}
+	}
+	stats.size = opening_book_size;
+	stats.lookups++;
+	if (move != NO_BOOK_MOVE) {
+		stats.hits++;
+	}
+	stats.last_cycles = get_cycle_count() - start;
+	return move;
+}
+
+const book_stats_t *book_get_stats(void) {
+	stats.size = opening_book_size;
+	return &stats;
+}
@@ -0,0 +1,42 @@
+/*
+ * book.h
+ *
+ * Opening book for the computer player. The book is a trie of opening
+ * lines stored in flash, it is generated from tools/openings.txt by
+ * tools/make_book.py (see there for the format).
+ */
+
+#ifndef BOOK_H_
+#define BOOK_H_
+
+#include <stdint.h>
+
+// lines in the book are never longer than this many moves
+#define BOOK_MAX_PLY 16
+
+// returned by book_lookup() when the position is not in the book
+#define NO_BOOK_MOVE 0xFF
+
+// the generated book data (book_data.c)
+extern const uint8_t opening_book[];
+extern const uint16_t opening_book_size;
+
+// statistics about the book and its use
+typedef struct {
+	uint16_t size;				// bytes of flash used by the book
+	uint16_t lookups;
+	uint16_t hits;				// lookups which found a book move
+	uint32_t last_cycles;		// clock cycles taken by the last lookup
+} book_stats_t;
+
+// look up the position reached from the start of the game by the given
+// moves (square numbers as in game.h, PASS_MOVE for a pass). Returns
+// the square to play next, or NO_BOOK_MOVE if the position is not in the
+// book. The book is checked in every orientation which leaves the
+// starting position unchanged
+uint8_t book_lookup(const uint8_t *moves, uint8_t count);
+
+// returns the book statistics
+const book_stats_t *book_get_stats(void);
+
+#endif /* BOOK_H_ */
@@ -0,0 +1,23 @@
+/*
+ * book_data.c
+ *
+ * Generated by tools/make_book.py from tools/openings.txt, do not edit.
+ *
+ * 25 lines, 73 positions, up to 16 plies deep, 73 bytes of flash.
+ */
+
+#include <avr/pgmspace.h>
+
+#include "book.h"
+
+const uint8_t opening_book[] PROGMEM = {
+	0xD4, 0xA5, 0xAA, 0xA2, 0xEB, 0x93, 0xAC, 0xB2, 0xE9, 0x9D, 0xED, 0xF3,
+	0xF4, 0xE1, 0xDA, 0x7D, 0x9A, 0xE1, 0xED, 0xF3, 0x7B, 0x73, 0x73, 0x95,
+	0x92, 0xDD, 0xDE, 0x26, 0x6D, 0x73, 0x5A, 0x72, 0x53, 0xAC, 0xD3, 0x9A,
+	0x15, 0xAD, 0xE2, 0xD5, 0xDD, 0x66, 0x22, 0x6A, 0x62, 0xAB, 0xE2, 0xEC,
+	0x53, 0x6D, 0x95, 0xDD, 0x93, 0x9A, 0xAC, 0xEB, 0x62, 0xE5, 0x4C, 0x8C,
+	0x9E, 0xD6, 0x44, 0xE5, 0x5A, 0x2A, 0x4D, 0xE5, 0x5E, 0xD3, 0xDA, 0xD5,
+	0x62,
+};
+
+const uint16_t opening_book_size = sizeof(opening_book);
@@ -0,0 +1,232 @@
+/*
+ * button_events.c
+ *
+ * A circular queue of button events, with the interrupt handler which
+ * sees the pushes and releases as its only writer and the main program
+ * as its only reader. As in serialio.c, queue_head is only changed by the
+ * writer (after storing the event) and queue_tail only by the reader
+ * (after copying it), so neither has to turn interrupts off.
+ *
+ * Repeats and long presses are made up by the reader from the pushes and
+ * releases it has taken: it knows which buttons are held and since when,
+ * and gives the next repeat or long press once its time has come.
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "buttons.h"
+#include "button_events.h"
+#include "idle.h"
+#include "timer0.h"
+
+#define BUTTON_QUEUE_MASK (BUTTON_QUEUE_SIZE - 1)
+#define NUM_BUTTONS 3
+
+static volatile button_event_t queue[BUTTON_QUEUE_SIZE];
+static volatile uint8_t queue_head;
+static volatile uint8_t queue_tail;
+
+// kept by the writer: when each button was last pushed (for its release)
+// and which buttons have had their push queued but not their release
+static uint32_t writer_press_times[NUM_BUTTONS];
+static uint8_t writer_held;
+
+// what the reader knows of the buttons being held: which they are (a bit
+// each), when they were pushed, when each should next repeat, and which
+// have already given their long press
+static uint8_t held;
+static uint32_t held_since[NUM_BUTTONS];
+static uint32_t next_repeat[NUM_BUTTONS];
+static uint8_t long_press_given;
+
+static volatile uint16_t dropped;
+static uint8_t max_waiting;
+
+void button_events_init(void) {
+	queue_head = 0;
+	queue_tail = 0;
+	writer_held = 0;
+	held = 0;
+	long_press_given = 0;
+	dropped = 0;
+	max_waiting = 0;
+}
+
+static void post_event(uint8_t button, uint8_t type, uint32_t time) {
+	uint8_t head = queue_head;
+	volatile button_event_t *event = &queue[head & BUTTON_QUEUE_MASK];
+	event->button = button;
+	event->type = type;
+	event->press_time = writer_press_times[button];
+	event->release_time = time;
+	uint32_t duration = time - writer_press_times[button];
+	event->duration = (duration > 0xFFFF) ? 0xFFFF : duration;
+	event->sequence = idle_next_sequence();
+	queue_head = head + 1;
+}
+
+void button_post_press(uint8_t button, uint32_t time) {
+	// a push is only queued if its release will fit as well (along with
+	// those of the other buttons being held), otherwise the reader would
+	// think the button was never let go
+	uint8_t free = BUTTON_QUEUE_SIZE - (uint8_t)(queue_head - queue_tail);
+	if (free <= NUM_BUTTONS) {
+		dropped++;
+		return;
+	}
+	writer_press_times[button] = time;
+	writer_held |= 1 << button;
+	post_event(button, BUTTON_PRESS, time);
+}
+
+void button_post_release(uint8_t button, uint32_t time) {
+	// the release of a push which wasn't queued is left out too
+	if (!(writer_held & (1 << button))) {
+		return;
+	}
+	writer_held &= ~(1 << button);
+	post_event(button, BUTTON_RELEASE, time);
+}
+
+// fill in an event made up by the reader for a button which is held
+static void held_event(button_event_t *event, uint8_t button, uint8_t type,
+		uint32_t now) {
+	event->button = button;
+	event->type = type;
+	event->press_time = held_since[button];
+	event->release_time = 0;
+	uint32_t duration = now - held_since[button];
+	event->duration = (duration > 0xFFFF) ? 0xFFFF : duration;
+}
+
+uint8_t button_get_event(button_event_t *event) {
+	// pushes and releases come first, they happened before now
+	buttons_poll();
+	uint8_t tail = queue_tail;
+	uint8_t waiting = queue_head - tail;
+	if (waiting) {
+		if (waiting > max_waiting) {
+			max_waiting = waiting;
+		}
+		volatile button_event_t *queued = &queue[tail & BUTTON_QUEUE_MASK];
+		event->button = queued->button;
+		event->type = queued->type;
+		event->press_time = queued->press_time;
+		event->release_time = queued->release_time;
+		event->duration = queued->duration;
+		event->sequence = queued->sequence;
+		queue_tail = tail + 1;
+
+		uint8_t bit = 1 << event->button;
+		if (event->type == BUTTON_PRESS) {
+			held |= bit;
+			long_press_given &= ~bit;
+			held_since[event->button] = event->press_time;
+			next_repeat[event->button] = event->press_time + BUTTON_REPEAT_DELAY;
+			// only a release has a release time
+			event->release_time = 0;
+		} else {
+			held &= ~bit;
+		}
+		return 1;
+	}
+
+	if (!held) {
+		return 0;
+	}
+	uint32_t now = get_current_time();
+	for (uint8_t button = 0; button < NUM_BUTTONS; button++) {
+		uint8_t bit = 1 << button;
+		if (!(held & bit)) {
+			continue;
+		}
+		uint8_t long_press_due = !(long_press_given & bit)
+				&& now - held_since[button] >= BUTTON_LONG_PRESS_MS;
+		uint8_t repeat_due = (BUTTON_REPEAT_MASK & bit)
+				&& (int32_t)(now - next_repeat[button]) >= 0;
+		if (!long_press_due && !repeat_due) {
+			continue;
+		}
+		// the button has been held for a while, so it has stopped bouncing
+		// and can be looked at to check that its release wasn't missed
+		if (!button_is_down(button)) {
+			held &= ~bit;
+			held_event(event, button, BUTTON_RELEASE, now);
+			event->release_time = now;
+			return 1;
+		}
+		if (long_press_due) {
+			long_press_given |= bit;
+			held_event(event, button, BUTTON_LONG_PRESS, now);
+			return 1;
+		}
+		// if the program was busy for a while, repeat once now rather
+		// than making up for all the repeats it missed
+		next_repeat[button] += BUTTON_REPEAT_INTERVAL;
+		if ((int32_t)(now - next_repeat[button]) >= 0) {
+			next_repeat[button] = now + BUTTON_REPEAT_INTERVAL;
+		}
+		held_event(event, button, BUTTON_REPEAT, now);
+		return 1;
+	}
+	return 0;
+}
+
+uint8_t button_event_sequence(uint8_t *sequence) {
+	buttons_poll();
+	uint8_t tail = queue_tail;
+	if (queue_head == tail) {
+		return 0;
+	}
+	*sequence = queue[tail & BUTTON_QUEUE_MASK].sequence;
+	return 1;
+}
+
+int8_t button_pushed(void) {
+	button_event_t event;
+	while (button_get_event(&event)) {
+		if (event.type == BUTTON_PRESS || event.type == BUTTON_REPEAT) {
+			return event.button;
+		}
+	}
+	return NO_BUTTON_PUSHED;
+}
+
+// the earlier of '*time' and 'due'
+static void earliest(uint32_t *time, uint32_t due) {
+	if ((int32_t)(due - *time) < 0) {
+		*time = due;
+	}
+}
+
+void button_wake_time(uint32_t *wake_time) {
+	if (queue_head != queue_tail) {
+		earliest(wake_time, get_current_time());
+		return;
+	}
+	for (uint8_t button = 0; button < NUM_BUTTONS; button++) {
+		uint8_t bit = 1 << button;
+		if (!(held & bit)) {
+			continue;
+		}
+		if (!(long_press_given & bit)) {
+			earliest(wake_time, held_since[button] + BUTTON_LONG_PRESS_MS);
+		}
+		if (BUTTON_REPEAT_MASK & bit) {
+			earliest(wake_time, next_repeat[button]);
+		}
+	}
+}
+
+void button_get_stats(button_stats_t *stats) {
+	// the interrupt handler can change the count while it is copied
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	stats->dropped = dropped;
+	if (interrupts_enabled) {
+		sei();
+	}
+	stats->max_waiting = max_waiting;
+}
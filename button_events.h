@@ -0,0 +1,36 @@
+/*
+ * button_events.h
+ *
+ * The queue of button events described in buttons.h. It is shared by
+ * the board's buttons.c, which adds pushes and releases from its
+ * interrupt handler, and the host build's replacement for it. It holds
+ * the reading side of buttons.h (button_get_event(), button_pushed() and
+ * button_get_stats()).
+ */
+
+#ifndef BUTTON_EVENTS_H_
+#define BUTTON_EVENTS_H_
+
+#include <stdint.h>
+
+// empty the queue and forget any buttons being held
+void button_events_init(void);
+
+// queue a push or a release of 'button' which happened at 'time'. Only
+// one caller may add events (the interrupt handler on the board), and it
+// must not be interrupted by another.
+void button_post_press(uint8_t button, uint32_t time);
+void button_post_release(uint8_t button, uint32_t time);
+
+// The two functions below are provided by buttons.c (or the host's
+// version of it) for the reader.
+
+// called before the queue is read, to add anything waiting to it (the
+// board's does nothing, its interrupt handler adds events straight away)
+void buttons_poll(void);
+
+// returns 1 if 'button' is down now. This lets the reader check that a
+// button it thinks is held hasn't been let go without it hearing.
+uint8_t button_is_down(uint8_t button);
+
+#endif /* BUTTON_EVENTS_H_ */
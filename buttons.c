@@ -2,121 +2,83 @@
  * buttons.c
  *
  * Authors: Peter Sutton, Luke Kamols
- */ 
+ */
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "buttons.h"
-#include "timer0.h"
+#include "button_events.h"
+#include "idle.h"
 
-// Global variable to keep track of the last button state so that we 
-// can detect changes when an interrupt fires. The lower 3 bits (0 to 2)
-// will correspond to the last state of port C pins 0 to 2.
-static volatile uint8_t last_button_state;
-
-// Our button queue. button_queue[0] is always the head of the queue. If we
-// take something off the queue we just move everything else along. We don't
-// use a circular buffer since it is usually expected that the queue is very
-// short. In most uses it will never have more than 1 element at a time.
-// This button queue can be changed by the interrupt handler below so we should
-// turn off interrupts if we're changing the queue outside the handler.
-#define BUTTON_QUEUE_SIZE 4
-static volatile uint8_t button_queue[BUTTON_QUEUE_SIZE];
-static volatile int8_t queue_length;
+// Pins C0 to C2
+#define BUTTON_PINS 0x07
 
 // These buttons are not hardware debounced, instead they must be software
-// debounced. The approach to this will be a simple one, rejecting any button
-// pushes within a short period of time after the most recent one
-static volatile uint32_t last_button_time[3];
-#define DEBOUNCE_TIME 30
+// debounced. The pins are sampled regularly (from timer 0's interrupt
+// handler) and a button is only taken to have changed once it has read
+// the same 4 samples in a row. button_state holds the debounced state
+// (bit n is set while button n is down). Each button has a 2 bit count of
+// the samples in a row which have differed from it, kept as a "vertical"
+// counter: bit n of count0 and count1 is button n's count, so all three
+// are counted at once with a few logic operations.
+static volatile uint8_t button_state;
+static uint8_t count0;
+static uint8_t count1;
 
-// Setup interrupt if any of pins C0 to C2 change. We do this
-// using a pin change interrupt. These pins correspond to pin
-// change interrupts PCINT8 to PCINT10 which are covered by
-// Pin change interrupt 1.
 void init_button_interrupts(void) {
-	// Enable the interrupt (see datasheet page 82)
-	PCICR |= (1<<PCIE1);
-	
-	// Make sure the interrupt flag is cleared (by writing a 
-	// 1 to it) (see datasheet page 82)
+	// Start with every button up and its count reset
+	button_state = 0;
+	count0 = 0xFF;
+	count1 = 0xFF;
+
+	// Empty the button event queue
+	button_events_init();
+
+#if BUTTON_WAKE_INTERRUPT
+	// Pin changes on C0 to C2 (pin change interrupts PCINT8 to PCINT10,
+	// covered by Pin change interrupt 1) only wake the CPU up, the
+	// handler does nothing. (See datasheet pages 82 and 83.)
 	PCIFR |= (1<<PCIF1);
-	
-	// Choose which pins we're interested in by setting
-	// the relevant bits in the mask register (see datasheet page 83)
-	PCMSK1 |= (1<<PCINT8)|(1<<PCINT9)|(1<<PCINT10);	
-	
-	// Empty the button push queue
-	queue_length = 0;
-	
-	// Set the last button pressed time for all pins to be zero
-	// This is not the current time as that would enforce an ordering
-	// on the hardware initialisation (i.e that the timer would have
-	// to be set up first)
-	for (uint8_t pin = 0; pin<=2; pin++) {
-		last_button_time[pin] = 0;
-	}
+	PCMSK1 |= (1<<PCINT8)|(1<<PCINT9)|(1<<PCINT10);
+	PCICR |= (1<<PCIE1);
+#endif
 }
 
-int8_t button_pushed(void) {
-	int8_t return_value = NO_BUTTON_PUSHED;	// Assume no button pushed
-	if(queue_length > 0) {
-		// Remove the first element off the queue and move all the other
-		// entries closer to the front of the queue. We turn off interrupts (if on)
-		// before we make any changes to the queue. If interrupts were on
-		// we turn them back on when done.
-		return_value = button_queue[0];
-		
-		// Save whether interrupts were enabled and turn them off
-		int8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
-		cli();
-		
-		for(uint8_t i = 1; i < queue_length; i++) {
-			button_queue[i-1] = button_queue[i];
-		}
-		queue_length--;
-		
-		if(interrupts_were_enabled) {
-			// Turn them back on again
-			sei();
-		}
-	}
-	return return_value;
-}
+void buttons_sample(uint32_t now) {
+	// The buttons which read differently from their debounced state
+	uint8_t changed = (PINC & BUTTON_PINS) ^ button_state;
+
+	// Count those buttons down one (from 3) and reset the others to 3
+	count0 = ~(count0 & changed);
+	count1 = count0 ^ (count1 & changed);
 
-// Interrupt handler for a change on buttons
-ISR(PCINT1_vect) {
-	// Get the current state of the buttons. We'll compare this with
-	// the last state to see what has changed.
-	uint8_t button_state = PINC & 0x07;
-	
-	uint32_t press_time = get_current_time();
-	// Get the time this button press occurred
-	
-	// Iterate over all the buttons and see which ones have changed.
-	// Any buttons which have changed have their debounce reference time updated
-	// Any button pushes are added to the queue of button pushes (if
-	// there is space). A button press is a transition from 0 in the 
-	// last_button_state bit to a 1 in the button_state.
-	for(uint8_t pin=0; pin<=2; pin++) {
-		if (button_state & (1<<pin) && !(last_button_state & (1<<pin))) {
-			// This is a transition from 0 to 1 on this pin
-			if (queue_length < BUTTON_QUEUE_SIZE && 
-					press_time >= last_button_time[pin] + DEBOUNCE_TIME) {
-				// Add the button push to the queue (and update the
-				// length of the queue
-				button_queue[queue_length++] = pin;	
+	// The buttons whose count has gone round to 3 again have read the
+	// same 4 times, they have really changed
+	changed &= count0 & count1;
+	if(changed) {
+		uint8_t state = button_state ^ changed;
+		button_state = state;
+		idle_post(IDLE_BUTTON);
+		for(uint8_t pin=0; pin<=2; pin++) {
+			if(changed & (1<<pin)) {
+				if(state & (1<<pin)) {
+					button_post_press(pin, now);
+				} else {
+					button_post_release(pin, now);
+				}
 			}
-			// Any button press, even if it is not added to the queue should
-			// be registered for debouncing
-			last_button_time[pin] = get_current_time();
-		} else if (!(button_state & (1<<pin)) && last_button_state & (1<<pin)) {
-			// This is a transition from 1 to 0 on this pin.
-			// Update the debounce timer anyway because it can bounce on release
-			last_button_time[pin] = get_current_time();
 		}
 	}
-	
-	// Remember this button state
-	last_button_state = button_state;
-}
\ No newline at end of file
+}
+
+void buttons_poll(void) {
+	// buttons_sample() queues everything as it happens
+}
+
+uint8_t button_is_down(uint8_t button) {
+	return (button_state >> button) & 1;
+}
+
+#if BUTTON_WAKE_INTERRUPT
+EMPTY_INTERRUPT(PCINT1_vect);
+#endif
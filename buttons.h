@@ -3,9 +3,17 @@
  *
  * Author: Peter Sutton
  *
- * We assume four push buttons (B0 to B2) are connected to pins C0 to C2. We configure
- * pin change interrupts on these pins.
- */ 
+ * We assume four push buttons (B0 to B2) are connected to pins C0 to C2. The pins
+ * are sampled every BUTTON_SAMPLE_MS milliseconds by timer 0's interrupt
+ * handler and debounced there (see buttons.c).
+ *
+ * Every push and release is queued as an event with the time it happened
+ * (see button_events.h for the queue). While a button is held the queue
+ * also gives repeat events for it, if it is one of BUTTON_REPEAT_MASK, and
+ * one long press event once it has been held for BUTTON_LONG_PRESS_MS.
+ * These are made up when the events are read, so holding a button costs
+ * no interrupts.
+ */
 
 
 #ifndef BUTTONS_H_
@@ -18,20 +26,106 @@
 #define BUTTON1_PUSHED 1
 #define BUTTON2_PUSHED 2
 
-/* Set up pin change interrupts on pins C0 to C2.
+/* How often the button pins are sampled (milliseconds). A change has to
+ * be seen in 4 samples in a row before it is taken, so a push is seen
+ * between 3 and 4 times this after the button settles.
+ */
+#ifndef BUTTON_SAMPLE_MS
+#define BUTTON_SAMPLE_MS 5
+#endif
+
+/* Set BUTTON_WAKE_INTERRUPT to 1 to keep the pin change interrupt on the
+ * button pins turned on, with a handler which does nothing, so that a
+ * push wakes the CPU from a sleep mode which stops timer 0.
+ */
+#ifndef BUTTON_WAKE_INTERRUPT
+#define BUTTON_WAKE_INTERRUPT 0
+#endif
+
+/* The number of events which can wait to be read (a power of two from 8
+ * to 128). Once there is only room left for the releases of the buttons
+ * being held, further pushes are counted and discarded.
+ */
+#ifndef BUTTON_QUEUE_SIZE
+#define BUTTON_QUEUE_SIZE 8
+#endif
+
+/* The buttons which repeat while held (bit n for button n, B1 and B2 move
+ * the cursor), how long they must be held before the first repeat and
+ * the time between repeats after that, and how long a button must be held
+ * for a long press (milliseconds).
+ */
+#ifndef BUTTON_REPEAT_MASK
+#define BUTTON_REPEAT_MASK ((1 << BUTTON1_PUSHED) | (1 << BUTTON2_PUSHED))
+#endif
+#define BUTTON_REPEAT_DELAY 400
+#define BUTTON_REPEAT_INTERVAL 100
+#define BUTTON_LONG_PRESS_MS 1000
+
+/* Kinds of button event */
+#define BUTTON_PRESS 0
+#define BUTTON_RELEASE 1
+#define BUTTON_REPEAT 2
+#define BUTTON_LONG_PRESS 3
+
+typedef struct {
+	uint8_t button;			/* 0 to 2 */
+	uint8_t type;			/* BUTTON_PRESS etc. */
+	uint32_t press_time;	/* when the button was pushed (get_current_time()) */
+	uint32_t release_time;	/* when it was let go, for BUTTON_RELEASE */
+	uint16_t duration;		/* how long it had been held (milliseconds) */
+	uint8_t sequence;		/* the order it was queued in among all the
+							 * input (see idle_next_sequence()) */
+} button_event_t;
+
+/* Counts of button events since the buttons were set up */
+typedef struct {
+	uint16_t dropped;		/* pushes lost as the queue was full */
+	uint8_t max_waiting;	/* the most events which have been waiting */
+} button_stats_t;
+
+/* Set up the buttons (and the pin change interrupt on pins C0 to C2, if
+ * BUTTON_WAKE_INTERRUPT is set).
  * It is assumed that global interrupts are off when this function is called
  * and are enabled sometime after this function is called.
  */
 void init_button_interrupts(void);
 
-/* Return the last button pushed (0 to 2) or -1 (NO_BUTTON_PUSHED) if 
- * there are no button pushes to return. (A small queue of button pushes
- * is kept. This function should be called frequently enough to
- * ensure the queue does not overflow. Excess button pushes are
- * discarded.)
+/* Sample the button pins and queue any pushes or releases with the time
+ * 'now'. This is called every BUTTON_SAMPLE_MS milliseconds from timer
+ * 0's interrupt handler.
+ */
+void buttons_sample(uint32_t now);
+
+/* Take the next button event and copy it into 'event'. Returns 1 if there
+ * was one, 0 if not.
+ */
+uint8_t button_get_event(button_event_t *event);
+
+/* If a push or release is waiting to be taken, set *sequence to the
+ * stamp it was queued with and return 1, otherwise return 0. Repeats and
+ * long presses are left out, button_get_event() makes them up when their
+ * time comes.
+ */
+uint8_t button_event_sequence(uint8_t *sequence);
+
+/* Return the last button pushed (0 to 2) or -1 (NO_BUTTON_PUSHED) if
+ * there are no button pushes to return. Repeats count as pushes, the
+ * other events are skipped. This function should be called frequently
+ * enough to ensure the queue does not overflow. Excess button pushes are
+ * discarded.
  */
 
 int8_t button_pushed(void);
 
+/* If there is a button event to be taken before '*wake_time' (one which
+ * is waiting, or the next repeat or long press of a button being held),
+ * set it to when the event is due.
+ */
+void button_wake_time(uint32_t *wake_time);
+
+/* Copy the counts of button events into 'stats' */
+void button_get_stats(button_stats_t *stats);
+
 
-#endif /* BUTTONS_H_ */
\ No newline at end of file
+#endif /* BUTTONS_H_ */
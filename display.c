@@ -8,22 +8,40 @@
 #include <avr/pgmspace.h>
 
 #include "display.h"
+#include "serialio.h"
 #include "terminalio.h"
 
+// a cell which has not been drawn since the board was, it shows the
+// terminal's own background colour
+#define CELL_BLANK 0xFF
+
+// what the terminal currently shows in each cell (an object, or
+// CELL_BLANK), indexed by y*WIDTH+x
+static uint8_t shown[WIDTH * HEIGHT];
+
+static display_stats_t stats;
+
 void initialise_display(void) {
+	// the board is drawn with every cell blank
+	for (uint8_t cell = 0; cell < WIDTH * HEIGHT; cell++) {
+		shown[cell] = CELL_BLANK;
+	}
+}
+
+void draw_board_line(uint8_t line) {
 	// first turn off the cursor
-	hide_cursor();
+	if (line == 0) {
+		hide_cursor();
+	}
 
-	// next build an empty board
+	// the lines between the rows are borders, the others hold the cells
 	set_display_attribute(FG_YELLOW);
-	for (uint8_t row = 0; row < HEIGHT; row++) {
-		move_terminal_cursor(TERMINAL_BOARD_X, TERMINAL_BOARD_Y+2*row);
-		printf_P(PSTR("+--+--+--+--+--+--+--+--+"));
-		move_terminal_cursor(TERMINAL_BOARD_X, TERMINAL_BOARD_Y+2*row+1);
-		printf_P(PSTR("|  |  |  |  |  |  |  |  |"));
+	move_terminal_cursor(TERMINAL_BOARD_X, TERMINAL_BOARD_Y+line);
+	if (line % 2 == 0) {
+		term_print_P(PSTR("+--+--+--+--+--+--+--+--+"));
+	} else {
+		term_print_P(PSTR("|  |  |  |  |  |  |  |  |"));
 	}
-	move_terminal_cursor(TERMINAL_BOARD_X, TERMINAL_BOARD_Y+2*HEIGHT);
-	printf_P(PSTR("+--+--+--+--+--+--+--+--+"));
 
 	// clear the colour settings so we don't print other things in yellow
 	normal_display_mode();
@@ -32,10 +50,28 @@ void initialise_display(void) {
 void start_display(void) {
 	move_terminal_cursor(TERMINAL_BOARD_X, TERMINAL_BOARD_Y);
 	set_display_attribute(FG_GREEN);
-	printf_P(PSTR("REVERSI"));
+	term_print_P(PSTR("REVERSI"));
 }
 
 void update_square_colour(uint8_t x, uint8_t y, uint8_t object) {
+	uint8_t term_x = TERMINAL_BOARD_X + 1 + 3 * x;
+	uint8_t term_y = TERMINAL_BOARD_Y + 1 + 2 * (HEIGHT - y - 1);
+
+	// nothing to send if the cell already shows this object
+	if (shown[y * WIDTH + x] == object) {
+		stats.cells_skipped++;
+		// the write would have cost what the others have, on average
+		// (how much depends on the cursor moves and attribute changes
+		// the terminal output could leave out)
+		if (stats.cells_written) {
+			stats.bytes_saved += stats.bytes_written / stats.cells_written;
+		}
+		return;
+	}
+	shown[y * WIDTH + x] = object;
+	stats.cells_written++;
+	uint32_t bytes_before = serial_bytes_sent();
+
 	// determine which colour corresponds to this object
 	DisplayParameter backgroundColour;
 	if (object == PLAYER_1) {
@@ -59,9 +95,13 @@ void update_square_colour(uint8_t x, uint8_t y, uint8_t object) {
 	// note that two spaces form roughly a square so that is used instead of one space
 	// also note that the terminal y values count from the top
 	// but our referencing counts from the bottom, so the y position is inverted
-	move_terminal_cursor(TERMINAL_BOARD_X + 1 + 3 * x,
-	TERMINAL_BOARD_Y + 1 + 2 * (HEIGHT - y - 1));
-	printf_P(PSTR("  ")); // print two spaces, since we set the background colour
+	move_terminal_cursor(term_x, term_y);
+	term_print_P(PSTR("  ")); // print two spaces, since we set the background colour
 
-	normal_display_mode(); // remove the display attribute
-}
\ No newline at end of file
+	normal_display_mode(); // remove the display attribute (when something else is drawn)
+	stats.bytes_written += serial_bytes_sent() - bytes_before;
+}
+
+const display_stats_t *get_display_stats(void) {
+	return &stats;
+}
@@ -7,6 +7,8 @@
 #ifndef DISPLAY_H_
 #define DISPLAY_H_
 
+#include <stdint.h>
+
 // display dimensions, these match the size of the board
 #define WIDTH  8
 #define HEIGHT 8
@@ -29,10 +31,28 @@
 #define TERMINAL_COLOUR_CURSOR	         BG_YELLOW
 #define TERMINAL_COLOUR_ILLEGAL_CURSOR   BG_BLUE
 
-// initialise the display for the board, this creates the display
-// for an empty board
+// counts of the writes to board cells
+typedef struct {
+	uint32_t cells_written;		// cells whose colour was sent to the terminal
+	uint32_t cells_skipped;		// cells which already showed that colour
+	uint32_t bytes_written;		// bytes sent for the cells written
+	uint32_t bytes_saved;		// bytes which skipping them saved, at the
+								// average cost of a cell written so far
+} display_stats_t;
+
+// the number of lines of the terminal the board takes up
+#define BOARD_LINES (2*HEIGHT+1)
+
+// initialise the display for the board, after this the board is drawn
+// one line at a time with draw_board_line() (the renderer does this so
+// that drawing it never has to wait for the serial port). Nothing is
+// sent to the terminal until then.
 void initialise_display(void);
 
+// draw line 'line' (0 at the top, up to BOARD_LINES-1) of an empty board,
+// the terminal's cursor is hidden with the first line
+void draw_board_line(uint8_t line);
+
 // shows a starting display
 void start_display(void);
 
@@ -40,6 +60,11 @@ void start_display(void);
 // of the object 'object'
 // 'object' is expected to be EMPTY_SQUARE, PLAYER_1, PLAYER_2 or 
 // CURSOR
+// nothing is sent if the square already shows that colour (the display
+// remembers what each square shows since initialise_display())
 void update_square_colour(uint8_t x, uint8_t y, uint8_t object);
 
+// returns the counts of cell writes since the program started
+const display_stats_t *get_display_stats(void);
+
 #endif 
\ No newline at end of file
@@ -0,0 +1,359 @@
+/*
+ * endgame.c
+ *
+ * Exact endgame solver. Every line is searched to the end of the game
+ * with alpha-beta, the score being the final disc difference (empty
+ * squares left when neither player can move go to the winner).
+ *
+ * This is the part of the game where the search spends nearly all of its
+ * time in positions with only a handful of empty squares, so:
+ *
+ *  - the empty squares are kept in a linked list, taken out while a move
+ *    there is searched and put back afterwards. A node only looks at the
+ *    squares that are still empty instead of scanning the whole board
+ *  - moves are ordered by parity. The board is split into its four
+ *    quadrants and moves in a quadrant with an odd number of empty
+ *    squares are tried first, as whoever moves last in a region usually
+ *    does best there. The list itself starts in order of how good the
+ *    squares usually are (corners first, squares next to corners last)
+ *  - with more empty squares left, where a good move order pays for
+ *    itself, moves which leave the opponent the fewest replies are tried
+ *    first
+ *  - the position is passed as two bitboards rather than a position_t,
+ *    the Zobrist hash is not needed as the endgame does not use the
+ *    transposition table
+ *
+ * The search gives up when its time budget runs out, the caller then
+ * falls back to the ordinary search.
+ */
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "endgame.h"
+#include "game.h"
+#include "timer0.h"
+
+// scores are disc differences so always lie inside this
+#define ENDGAME_INFINITY 127
+
+// the clock is only checked every (TIME_CHECK_MASK + 1) nodes
+#define TIME_CHECK_MASK 255
+
+// moves are sorted by the opponent's mobility when more than this many
+// squares are empty, below it the cost of sorting is more than it saves
+#define SORT_EMPTIES 7
+
+// the most legal moves a position with ENDGAME_WLD_EMPTIES empty squares
+// can have
+#define MAX_ENDGAME_MOVES ENDGAME_WLD_EMPTIES
+
+// the empty squares are a list threaded through empty_next[], starting
+// at empty_next[EMPTY_HEAD] and ending with EMPTY_END
+#define EMPTY_HEAD	64
+#define EMPTY_END	PASS_MOVE
+
+// which quadrant of the board a square is in, 0 to 3
+#define QUADRANT(sq) (((SQUARE_Y(sq) >> 2) << 1) | (SQUARE_X(sq) >> 2))
+
+// squares in the order they are put in the empty list, roughly from best
+// to worst: corners, the middle of the edges, the centre, then the
+// squares next to the corners
+static const uint8_t square_order[64] PROGMEM = {
+	SQUARE(0,0), SQUARE(7,0), SQUARE(0,7), SQUARE(7,7),
+	SQUARE(2,0), SQUARE(5,0), SQUARE(0,2), SQUARE(7,2),
+	SQUARE(0,5), SQUARE(7,5), SQUARE(2,7), SQUARE(5,7),
+	SQUARE(3,0), SQUARE(4,0), SQUARE(0,3), SQUARE(7,3),
+	SQUARE(0,4), SQUARE(7,4), SQUARE(3,7), SQUARE(4,7),
+	SQUARE(2,2), SQUARE(5,2), SQUARE(2,5), SQUARE(5,5),
+	SQUARE(3,2), SQUARE(4,2), SQUARE(2,3), SQUARE(5,3),
+	SQUARE(2,4), SQUARE(5,4), SQUARE(3,5), SQUARE(4,5),
+	SQUARE(3,3), SQUARE(4,3), SQUARE(3,4), SQUARE(4,4),
+	SQUARE(3,1), SQUARE(4,1), SQUARE(1,3), SQUARE(6,3),
+	SQUARE(1,4), SQUARE(6,4), SQUARE(3,6), SQUARE(4,6),
+	SQUARE(2,1), SQUARE(5,1), SQUARE(1,2), SQUARE(6,2),
+	SQUARE(1,5), SQUARE(6,5), SQUARE(2,6), SQUARE(5,6),
+	SQUARE(1,0), SQUARE(6,0), SQUARE(0,1), SQUARE(7,1),
+	SQUARE(0,6), SQUARE(7,6), SQUARE(1,7), SQUARE(6,7),
+	SQUARE(1,1), SQUARE(6,1), SQUARE(1,6), SQUARE(6,6)
+};
+
+static ENGINE_TLS uint8_t empty_next[EMPTY_HEAD + 1];
+
+// bit q is set while quadrant q has an odd number of empty squares
+static ENGINE_TLS uint8_t parity;
+
+static ENGINE_TLS uint32_t deadline;
+static ENGINE_TLS uint32_t nodes;
+static ENGINE_TLS uint8_t aborted;
+
+uint8_t count_empties(const position_t *pos) {
+	return 64 - count_bits(pos->pieces[0] | pos->pieces[1]);
+}
+
+// score of a finished game for the player owning own
+static int8_t final_disc_difference(bitboard_t own, bitboard_t opp) {
+	int8_t own_count = count_bits(own);
+	int8_t opp_count = count_bits(opp);
+	int8_t empties = 64 - own_count - opp_count;
+	if (own_count > opp_count) {
+		return own_count - opp_count + empties;
+	} else if (own_count < opp_count) {
+		return own_count - opp_count - empties;
+	}
+	return 0;
+}
+
+static int8_t solve(bitboard_t own, bitboard_t opp, int8_t alpha, int8_t beta,
+		uint8_t empties, uint8_t passed);
+
+// search the position after playing sq, which has been taken out of the
+// empty list. Returns the score for the player who played sq
+static inline int8_t solve_child(bitboard_t own, bitboard_t opp, bitboard_t flips,
+		uint8_t sq, int8_t alpha, int8_t beta, uint8_t empties) {
+	parity ^= 1 << QUADRANT(sq);
+	int8_t score = -solve(opp ^ flips, own | flips | SQUARE_BIT(sq),
+			-beta, -alpha, empties - 1, 0);
+	parity ^= 1 << QUADRANT(sq);
+	return score;
+}
+
+// the last empty square, whoever can play there does (own first)
+static int8_t solve_last(bitboard_t own, bitboard_t opp) {
+	uint8_t sq = empty_next[EMPTY_HEAD];
+	bitboard_t flips = compute_flips(own, opp, sq);
+	if (flips) {
+		return final_disc_difference(own | flips | SQUARE_BIT(sq), opp ^ flips);
+	}
+	flips = compute_flips(opp, own, sq);
+	if (flips) {
+		return final_disc_difference(own ^ flips, opp | flips | SQUARE_BIT(sq));
+	}
+	return final_disc_difference(own, opp);
+}
+
+// moves tried in list order, odd quadrants first
+static int8_t solve_parity(bitboard_t own, bitboard_t opp, int8_t alpha,
+		int8_t beta, uint8_t empties, uint8_t *moved) {
+	int8_t best = -ENDGAME_INFINITY;
+	for (uint8_t pass = 0; pass < 2; pass++) {
+		uint8_t odd = (pass == 0);
+		uint8_t prev = EMPTY_HEAD;
+		for (uint8_t sq = empty_next[prev]; sq != EMPTY_END;
+				prev = sq, sq = empty_next[sq]) {
+			if (((parity >> QUADRANT(sq)) & 1) != odd) {
+				continue;
+			}
+			bitboard_t flips = compute_flips(own, opp, sq);
+			if (!flips) {
+				continue;
+			}
+			*moved = 1;
+			empty_next[prev] = empty_next[sq];
+			int8_t score = solve_child(own, opp, flips, sq, alpha, beta, empties);
+			empty_next[prev] = sq;
+
+			if (score > best) {
+				best = score;
+				if (score > alpha) {
+					alpha = score;
+					if (alpha >= beta) {
+						return best;
+					}
+				}
+			}
+		}
+	}
+	return best;
+}
+
+// collects the legal moves from the empty list along with the square
+// before each one in the list (to unlink it with) and a sort key: the
+// number of replies the opponent would have, doubled, plus one for an
+// even quadrant. Returns the number of moves
+static uint8_t collect_moves(bitboard_t own, bitboard_t opp, uint8_t *squares,
+		uint8_t *prevs, uint8_t *keys) {
+	uint8_t count = 0;
+	uint8_t prev = EMPTY_HEAD;
+	for (uint8_t sq = empty_next[prev]; sq != EMPTY_END;
+			prev = sq, sq = empty_next[sq]) {
+		bitboard_t flips = compute_flips(own, opp, sq);
+		if (!flips) {
+			continue;
+		}
+		bitboard_t replies = generate_moves(opp ^ flips, own | flips | SQUARE_BIT(sq));
+		squares[count] = sq;
+		prevs[count] = prev;
+		keys[count] = 2 * count_bits(replies) + !((parity >> QUADRANT(sq)) & 1);
+		count++;
+	}
+	return count;
+}
+
+// moves the entry with the smallest key to position i
+static inline void select_move(uint8_t i, uint8_t count, uint8_t *squares,
+		uint8_t *prevs, uint8_t *keys) {
+	uint8_t min = i;
+	for (uint8_t j = i + 1; j < count; j++) {
+		if (keys[j] < keys[min]) {
+			min = j;
+		}
+	}
+	uint8_t t;
+	t = squares[i]; squares[i] = squares[min]; squares[min] = t;
+	t = prevs[i]; prevs[i] = prevs[min]; prevs[min] = t;
+	t = keys[i]; keys[i] = keys[min]; keys[min] = t;
+}
+
+// moves tried in order of how few replies they leave the opponent
+static int8_t solve_sorted(bitboard_t own, bitboard_t opp, int8_t alpha,
+		int8_t beta, uint8_t empties, uint8_t *moved) {
+	uint8_t squares[MAX_ENDGAME_MOVES];
+	uint8_t prevs[MAX_ENDGAME_MOVES];
+	uint8_t keys[MAX_ENDGAME_MOVES];
+	uint8_t count = collect_moves(own, opp, squares, prevs, keys);
+	int8_t best = -ENDGAME_INFINITY;
+
+	for (uint8_t i = 0; i < count; i++) {
+		select_move(i, count, squares, prevs, keys);
+		uint8_t sq = squares[i];
+		// the list is put back exactly as it was after each move, so the
+		// square before this one is still the one found when collecting
+		bitboard_t flips = compute_flips(own, opp, sq);
+		empty_next[prevs[i]] = empty_next[sq];
+		int8_t score = solve_child(own, opp, flips, sq, alpha, beta, empties);
+		empty_next[prevs[i]] = sq;
+
+		if (score > best) {
+			best = score;
+			if (score > alpha) {
+				alpha = score;
+				if (alpha >= beta) {
+					break;
+				}
+			}
+		}
+	}
+	*moved = count != 0;
+	return best;
+}
+
+static int8_t solve(bitboard_t own, bitboard_t opp, int8_t alpha, int8_t beta,
+		uint8_t empties, uint8_t passed) {
+	// the value returned once the time has run out does not matter, the
+	// whole solve is thrown away
+	if ((++nodes & TIME_CHECK_MASK) == 0 && get_current_time() >= deadline) {
+		aborted = 1;
+	}
+	if (aborted) {
+		return 0;
+	}
+
+	if (empties == 0) {
+		return (int8_t)count_bits(own) - (int8_t)count_bits(opp);
+	}
+	if (empties == 1) {
+		return solve_last(own, opp);
+	}
+
+	uint8_t moved = 0;
+	int8_t best;
+	if (empties > SORT_EMPTIES) {
+		best = solve_sorted(own, opp, alpha, beta, empties, &moved);
+	} else {
+		best = solve_parity(own, opp, alpha, beta, empties, &moved);
+	}
+	if (moved) {
+		return best;
+	}
+
+	// no moves: pass, or the game is over if the opponent just passed too
+	if (passed) {
+		return final_disc_difference(own, opp);
+	}
+	return -solve(opp, own, -beta, -alpha, empties, 1);
+}
+
+// builds the list of empty squares and their quadrant parity
+static void setup_empties(bitboard_t empty) {
+	uint8_t prev = EMPTY_HEAD;
+	parity = 0;
+	for (uint8_t i = 0; i < 64; i++) {
+		uint8_t sq = pgm_read_byte(&square_order[i]);
+		if (empty & SQUARE_BIT(sq)) {
+			empty_next[prev] = sq;
+			prev = sq;
+			parity ^= 1 << QUADRANT(sq);
+		}
+	}
+	empty_next[prev] = EMPTY_END;
+}
+
+endgame_result_t solve_endgame(const position_t *pos, uint8_t mode,
+		uint16_t time_budget_ms) {
+	endgame_result_t result;
+	uint32_t start_time = get_current_time();
+	deadline = start_time + time_budget_ms;
+	nodes = 0;
+	aborted = 0;
+
+	bitboard_t own = pos->pieces[pos->side];
+	bitboard_t opp = pos->pieces[pos->side ^ 1];
+	uint8_t empties = count_empties(pos);
+	result.best_move = PASS_MOVE;
+	result.score = 0;
+	result.solved = 0;
+	result.nodes = 0;
+	result.time_ms = 0;
+	if (empties > MAX_ENDGAME_MOVES) {
+		// too many empty squares to ever finish
+		return result;
+	}
+	setup_empties(~(own | opp));
+
+	// only the sign of the score matters when solving for win/loss/draw,
+	// the narrow window lets far more of the tree be cut off
+	int8_t alpha = (mode == ENDGAME_WLD) ? -1 : -ENDGAME_INFINITY;
+	int8_t beta = (mode == ENDGAME_WLD) ? 1 : ENDGAME_INFINITY;
+
+	uint8_t squares[MAX_ENDGAME_MOVES];
+	uint8_t prevs[MAX_ENDGAME_MOVES];
+	uint8_t keys[MAX_ENDGAME_MOVES];
+	uint8_t count = collect_moves(own, opp, squares, prevs, keys);
+	if (count == 0) {
+		// the player to move has to pass (or the game is already over)
+		result.score = -solve(opp, own, -beta, -alpha, empties, 1);
+	} else {
+		int8_t best = -ENDGAME_INFINITY;
+		for (uint8_t i = 0; i < count; i++) {
+			select_move(i, count, squares, prevs, keys);
+			uint8_t sq = squares[i];
+			bitboard_t flips = compute_flips(own, opp, sq);
+			empty_next[prevs[i]] = empty_next[sq];
+			int8_t score = solve_child(own, opp, flips, sq, alpha, beta, empties);
+			empty_next[prevs[i]] = sq;
+			if (aborted) {
+				break;
+			}
+			if (score > best) {
+				best = score;
+				result.best_move = sq;
+				if (score > alpha) {
+					alpha = score;
+					if (alpha >= beta) {
+						break;
+					}
+				}
+			}
+		}
+		result.score = best;
+	}
+
+	if (mode == ENDGAME_WLD) {
+		result.score = (result.score > 0) - (result.score < 0);
+	}
+	result.solved = !aborted;
+	result.nodes = nodes;
+	result.time_ms = get_current_time() - start_time;
+	return result;
+}
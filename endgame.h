@@ -0,0 +1,57 @@
+/*
+ * endgame.h
+ *
+ * Exact endgame solver for the computer player. Near the end of the game
+ * there are few enough empty squares left to search every line to the
+ * end, so the result of the game can be found exactly instead of being
+ * estimated by the evaluation.
+ */
+
+#ifndef ENDGAME_H_
+#define ENDGAME_H_
+
+#include <stdint.h>
+
+#include "game.h"
+
+// positions with this many empty squares or fewer are solved exactly
+// (final disc difference), define ENDGAME_EMPTIES when compiling to
+// choose another threshold. A solve which runs out of time is given up
+// and the normal search is used instead, so a threshold a little too
+// high for the board only costs the time given to the solver.
+#ifndef ENDGAME_EMPTIES
+#ifdef __AVR__
+#define ENDGAME_EMPTIES 12
+#else
+#define ENDGAME_EMPTIES 20
+#endif
+#endif
+
+// with a couple more empty squares than that only win/loss/draw is
+// worked out, which is much quicker than the exact disc difference
+#ifndef ENDGAME_WLD_EMPTIES
+#define ENDGAME_WLD_EMPTIES (ENDGAME_EMPTIES + 2)
+#endif
+
+// what the solver should find
+#define ENDGAME_EXACT	0	// the final disc difference
+#define ENDGAME_WLD		1	// only whether the game is won, lost or drawn
+
+typedef struct {
+	uint8_t best_move;	// square to play, or PASS_MOVE
+	int8_t score;		// disc difference at the end of the game for the
+						// player to move (just -1, 0 or 1 for ENDGAME_WLD)
+	uint8_t solved;		// 0 if the time ran out before the solve finished
+	uint32_t nodes;
+	uint32_t time_ms;
+} endgame_result_t;
+
+// returns the number of empty squares in a position
+uint8_t count_empties(const position_t *pos);
+
+// solve the position for the player to move, giving up after roughly
+// time_budget_ms milliseconds. mode is ENDGAME_EXACT or ENDGAME_WLD
+endgame_result_t solve_endgame(const position_t *pos, uint8_t mode,
+		uint16_t time_budget_ms);
+
+#endif /* ENDGAME_H_ */
@@ -7,11 +7,13 @@
  */ 
 
 #include <avr/io.h>
-#include <stdlib.h>
+#include <avr/pgmspace.h>
 
 #include "game.h"
 #include "display.h"
+#include "render.h"
 #include "scoring.h"
+#include "book.h"
 
 #define CURSOR_X_START 5
 #define CURSOR_Y_START 3
@@ -20,44 +22,321 @@
 static const uint8_t p1_start_pieces[START_PIECES][2] = { {3, 3}, {4, 4} };
 static const uint8_t p2_start_pieces[START_PIECES][2] = { {3, 4}, {4, 3} };
 
-uint8_t board[WIDTH][HEIGHT];
+// the position of the game being played
+position_t game;
 uint8_t cursor_x;
 uint8_t cursor_y;
 uint8_t cursor_visible;
-uint8_t current_player;
-uint8_t valid_direction[WIDTH][HEIGHT][8];
 uint8_t no_move_game_over = 0;
 
-void initialise_board(void) {
-	
-	// initialise the display we are using
-	initialise_display();
-	
-	// initialise the board to be all empty
-	for (uint8_t x = 0; x < WIDTH; x++) {
-		for (uint8_t y = 0; y < HEIGHT; y++) {
-			board[x][y] = EMPTY_SQUARE;
-		}
+// the legal moves of the current player, and how many pieces each of
+// them would flip. These are worked out once whenever the turn changes
+// (see refresh_turn_moves()) so that the cursor and the pass/game over
+// checks only have to look them up
+bitboard_t turn_moves;
+uint8_t flip_counts[WIDTH * HEIGHT];
+
+// the opening moves of the game (only as many as the opening book could
+// know about are kept) and the number of moves played so far
+uint8_t move_history[BOOK_MAX_PLY];
+uint8_t moves_played;
+
+// masks used to stop pieces wrapping around the board edges when a
+// bitboard is shifted one column left or right
+#define NOT_FILE_A	0xFEFEFEFEFEFEFEFEULL
+#define NOT_FILE_H	0x7F7F7F7F7F7F7F7FULL
+
+// the eight directions a line of flipped pieces can run in
+#define DIRECTION_UP			0
+#define DIRECTION_UP_RIGHT		1
+#define DIRECTION_RIGHT			2
+#define DIRECTION_DOWN_RIGHT	3
+#define DIRECTION_DOWN			4
+#define DIRECTION_DOWN_LEFT		5
+#define DIRECTION_LEFT			6
+#define DIRECTION_UP_LEFT		7
+#define NUM_DIRECTIONS			8
+
+// random keys for Zobrist hashing, one for each player on each square
+// (keys 0-63 for player 1, 64-127 for player 2) and one for the player to
+// move (key 128). They are kept in flash as zobrist_t, so the AVR build
+// keeps only the low 32 bits of each
+#define ZOBRIST_SIDE_KEY 128
+#define KEY(key) ((zobrist_t)key##ULL)
+static const zobrist_t zobrist_keys[129] PROGMEM = {
+	KEY(0xE3B4578A3E158E97), KEY(0x8136BE1B4582B9C0), KEY(0x99B5EDF749F273CA),
+	KEY(0x559B16952B80F220), KEY(0xF971FA5786E2565C), KEY(0x0B3A9FBE5210E95F),
+	KEY(0xB08131B1B222648F), KEY(0xFCF23A680CA75655), KEY(0xABB0A695B1EF6E05),
+	KEY(0x9C0A1A53AE7EDC54), KEY(0xFFD32D8A37E1BDE1), KEY(0xCFC372E69439C53C),
+	KEY(0x7E819841D25C6A4C), KEY(0xD97E9E77DF50A27E), KEY(0xA702A5931B3991EF),
+	KEY(0x46DA71EE0DEC47B3), KEY(0xEB53FA8BB5D66644), KEY(0xA349FFD03B1F5223),
+	KEY(0x9474CDE4D587C17B), KEY(0x4C627184D84CF3E2), KEY(0x3A3A91373C616455),
+	KEY(0xB24D69430062077A), KEY(0x781C0B1DFB95A80A), KEY(0xA2FB96627428A678),
+	KEY(0xFC7C2F6B0E770192), KEY(0x65661EF710AFC66C), KEY(0x93BD08A69CD3C7BF),
+	KEY(0xF748FC58DD8B711D), KEY(0xCD9D7C22B007569C), KEY(0x1EACBEBEEA83ED35),
+	KEY(0x402191BCA4E71F1A), KEY(0x7DE5D555EFCDF4A0), KEY(0x69F8154B0C7926E5),
+	KEY(0xD3801797B7909577), KEY(0xC8BFB143656E04C5), KEY(0x97B4D8D74CB17A08),
+	KEY(0x07778A5077EC3C48), KEY(0xBC23121B7E72B81B), KEY(0xF358BF1C43967C60),
+	KEY(0x6175BB71DDC9D337), KEY(0xD07E3D90C55DA043), KEY(0xB54945790FCB686B),
+	KEY(0x728597A99BC528E9), KEY(0x5DCE472F037659B2), KEY(0x895B7E4312F2FDC9),
+	KEY(0x285EF82E357018F2), KEY(0xC731B128719942D3), KEY(0xA574C27945274596),
+	KEY(0x1C2B20E803D8097B), KEY(0x162AFAFB785B07C9), KEY(0x4CB196101C462726),
+	KEY(0x0A7D754704CF3037), KEY(0x4B564A2D750E570B), KEY(0xFA34FA4A46B6BFB4),
+	KEY(0x0CADBF6CB53E0CD2), KEY(0xEA38448D480C3D98), KEY(0xA59AE9AEA1F6D43A),
+	KEY(0xBE3BC6E70D3754EF), KEY(0x86CA7BD2DB035D28), KEY(0x394BF8CAEAC2C6A7),
+	KEY(0xA2A1AFEBEFF83B0F), KEY(0x92DA77D8DE23A910), KEY(0xC0055A546D73292A),
+	KEY(0x62291E8B70A9B6EF), KEY(0x7434E35175CCBAE9), KEY(0x3663D375C66EE761),
+	KEY(0x31F1182A15EADE52), KEY(0x828612B6FA2FC2F4), KEY(0xBF0E62D3AE7B8DE7),
+	KEY(0x72BF84BA56774BC2), KEY(0xA7F2081A17B7F154), KEY(0x54DB7AC208C2459A),
+	KEY(0x48D96B1A90198D92), KEY(0x9F25C5264C60CD96), KEY(0xDE04D0165DAC9553),
+	KEY(0x420DABC4FD67450B), KEY(0x7107FA2E3F8D003A), KEY(0x1F77B3C6BE07D8F3),
+	KEY(0x564996B60D3F582A), KEY(0x72665E5CC1816957), KEY(0x643CFC7843A88D18),
+	KEY(0x7B73E2100B703836), KEY(0x97518A9EF49DB0F6), KEY(0xB3484F7861C3ED40),
+	KEY(0xB56D6F175FB0A51B), KEY(0x5CB8708528E96B63), KEY(0x61F081A8CEB25B2D),
+	KEY(0xF53BA1A9DE713C45), KEY(0xCBBFAB6EC35421D6), KEY(0x14A86206DF29CDAC),
+	KEY(0xCF5771853472F45E), KEY(0x4E6DC29AF74B4374), KEY(0x8EEAB478D81FBB0E),
+	KEY(0x56347A52199AB7BB), KEY(0x68D4D26C1FECCC21), KEY(0xE3EA2067ECC568E5),
+	KEY(0x0B855A8B1EF8E1AC), KEY(0x7ACCF08C3B418512), KEY(0x7ECDB93FFC9C180A),
+	KEY(0x94B9D790512E0814), KEY(0x08F7EAAE38C5CD9A), KEY(0x4AE2EB8ED60209B8),
+	KEY(0xEDBF6A829A56D3E8), KEY(0x815C9F72A7C02CB5), KEY(0xAB76BD5859A6CA58),
+	KEY(0x8BDD1BCDBF062369), KEY(0x554F656A60CB852D), KEY(0x97C8A4EE5B48B7EC),
+	KEY(0x00EE0A9162133657), KEY(0xA3D66B109781CBA6), KEY(0x9B99DD3FAD40E930),
+	KEY(0xB6BA9EC0D4C46C48), KEY(0x0F48759229B1C846), KEY(0xC9DEAC394CD75B10),
+	KEY(0x58D7B0C460D0E943), KEY(0xFE27BA73A0E6B532), KEY(0x054287EF37CD3C27),
+	KEY(0x295F3745DDEA5949), KEY(0xC46F5F6448CE0FDC), KEY(0xD3C407A8BD4608F5),
+	KEY(0xC4A62152FA21C4B3), KEY(0x29D02CBFF3F40CD5), KEY(0x395DD501B0BA8A99),
+	KEY(0x33B31C2DCDA587F7), KEY(0xAF6C5E9BA83A21FF), KEY(0x638E47B06EB244D7),
+	KEY(0xD0204EE186C5CDF1), KEY(0x26CABC87F8E626D5), KEY(0xDB0986FA4CA5B33D),
+};
+#undef KEY
+
+/////////////////////////////// engine ///////////////////////////////
+
+static inline zobrist_t zobrist_key(uint8_t index) {
+#ifdef __AVR__
+	return pgm_read_dword(&zobrist_keys[index]);
+#else
+	return zobrist_keys[index];
+#endif
+}
+
+// move every piece of the bitboard one square in the given direction,
+// pieces which would leave the board are discarded
+static inline bitboard_t shift_board(bitboard_t board, uint8_t direction) {
+	switch (direction) {
+		case DIRECTION_UP:			return board << 8;
+		case DIRECTION_UP_RIGHT:	return (board << 9) & NOT_FILE_A;
+		case DIRECTION_RIGHT:		return (board << 1) & NOT_FILE_A;
+		case DIRECTION_DOWN_RIGHT:	return (board >> 7) & NOT_FILE_A;
+		case DIRECTION_DOWN:		return board >> 8;
+		case DIRECTION_DOWN_LEFT:	return (board >> 9) & NOT_FILE_H;
+		case DIRECTION_LEFT:		return (board >> 1) & NOT_FILE_H;
+		default:					return (board << 7) & NOT_FILE_H;
 	}
-	
-	// now load in the starting pieces for player 1
+}
+
+void init_position(position_t *pos) {
+	pos->pieces[0] = 0;
+	pos->pieces[1] = 0;
 	for (uint8_t i = 0; i < START_PIECES; i++) {
-		uint8_t x = p1_start_pieces[i][0];
-		uint8_t y = p1_start_pieces[i][1];
-		board[x][y] = PLAYER_1; // place in array
-		update_square_colour(x, y, PLAYER_1); // show on board
+		pos->pieces[0] |= SQUARE_BIT(SQUARE(p1_start_pieces[i][0], p1_start_pieces[i][1]));
+		pos->pieces[1] |= SQUARE_BIT(SQUARE(p2_start_pieces[i][0], p2_start_pieces[i][1]));
+	}
+	// player 1 always starts
+	pos->side = 0;
+	pos->hash = compute_hash(pos);
+}
+
+zobrist_t compute_hash(const position_t *pos) {
+	zobrist_t hash = pos->side ? zobrist_key(ZOBRIST_SIDE_KEY) : 0;
+	for (uint8_t sq = 0; sq < 64; sq++) {
+		if (pos->pieces[0] & SQUARE_BIT(sq)) {
+			hash ^= zobrist_key(sq);
+		} else if (pos->pieces[1] & SQUARE_BIT(sq)) {
+			hash ^= zobrist_key(64 + sq);
+		}
+	}
+	return hash;
+}
+
+bitboard_t generate_moves(bitboard_t own, bitboard_t opp) {
+	bitboard_t empty = ~(own | opp);
+	bitboard_t moves = 0;
+	for (uint8_t direction = 0; direction < NUM_DIRECTIONS; direction++) {
+		// grow a run of opponent pieces out of our own pieces, a run
+		// can be at most six long, then the square beyond the end of
+		// the run is a legal move if it is empty
+		bitboard_t run = shift_board(own, direction) & opp;
+		run |= shift_board(run, direction) & opp;
+		run |= shift_board(run, direction) & opp;
+		run |= shift_board(run, direction) & opp;
+		run |= shift_board(run, direction) & opp;
+		run |= shift_board(run, direction) & opp;
+		moves |= shift_board(run, direction) & empty;
+	}
+	return moves;
+}
+
+bitboard_t compute_flips(bitboard_t own, bitboard_t opp, uint8_t sq) {
+	bitboard_t placed = SQUARE_BIT(sq);
+	bitboard_t flips = 0;
+	for (uint8_t direction = 0; direction < NUM_DIRECTIONS; direction++) {
+		// grow a run of opponent pieces out of the placed piece, it is
+		// only flipped if it is closed off by one of our own pieces
+		bitboard_t run = shift_board(placed, direction) & opp;
+		run |= shift_board(run, direction) & opp;
+		run |= shift_board(run, direction) & opp;
+		run |= shift_board(run, direction) & opp;
+		run |= shift_board(run, direction) & opp;
+		run |= shift_board(run, direction) & opp;
+		if (shift_board(run, direction) & own) {
+			flips |= run;
+		}
+	}
+	return flips;
+}
+
+bitboard_t legal_moves(const position_t *pos) {
+	return generate_moves(pos->pieces[pos->side], pos->pieces[pos->side ^ 1]);
+}
+
+undo_t make_move(position_t *pos, uint8_t sq) {
+	undo_t undo;
+	undo.square = sq;
+	undo.flipped = 0;
+	undo.hash = pos->hash;
+	zobrist_t hash = pos->hash ^ zobrist_key(ZOBRIST_SIDE_KEY);
+	if (sq != PASS_MOVE) {
+		bitboard_t *own = &pos->pieces[pos->side];
+		bitboard_t *opp = &pos->pieces[pos->side ^ 1];
+		undo.flipped = compute_flips(*own, *opp, sq);
+		*own |= undo.flipped | SQUARE_BIT(sq);
+		*opp ^= undo.flipped;
+
+		// the placed piece is added, and every flipped piece swaps
+		// from the opponent's key to the mover's key
+		uint8_t own_keys = pos->side ? 64 : 0;
+		hash ^= zobrist_key(own_keys + sq);
+		bitboard_t flipped = undo.flipped;
+		while (flipped) {
+			uint8_t flip_sq = (uint8_t)__builtin_ctzll(flipped);
+			flipped &= flipped - 1;
+			hash ^= zobrist_key(flip_sq) ^ zobrist_key(64 + flip_sq);
+		}
+	}
+	pos->hash = hash;
+	pos->side ^= 1;
+	return undo;
+}
+
+void unmake_move(position_t *pos, const undo_t *undo) {
+	pos->side ^= 1;
+	pos->hash = undo->hash;
+	if (undo->square != PASS_MOVE) {
+		pos->pieces[pos->side] ^= undo->flipped | SQUARE_BIT(undo->square);
+		pos->pieces[pos->side ^ 1] |= undo->flipped;
+	}
+}
+
+uint8_t must_pass(const position_t *pos) {
+	return !legal_moves(pos) && generate_moves(pos->pieces[pos->side ^ 1],
+			pos->pieces[pos->side]);
+}
+
+uint8_t position_game_over(const position_t *pos) {
+	return !legal_moves(pos) && !generate_moves(pos->pieces[pos->side ^ 1],
+			pos->pieces[pos->side]);
+}
+
+move_result_t apply_move(position_t *pos, uint8_t sq) {
+	move_result_t result;
+	result.square = sq;
+	result.player = pos->side + PLAYER_1;
+	undo_t undo = make_move(pos, sq);
+	result.changed = undo.flipped | SQUARE_BIT(sq);
+
+	// if the next player has nowhere to go the turn passes straight back,
+	// if neither player can move the game is over
+	result.passed = 0;
+	result.game_over = 0;
+	if (!legal_moves(pos)) {
+		if (must_pass(pos)) {
+			make_move(pos, PASS_MOVE);
+			result.passed = 1;
+		} else {
+			result.game_over = 1;
+		}
 	}
+	result.next_player = pos->side + PLAYER_1;
+	return result;
+}
+
+uint8_t count_bits(bitboard_t board) {
+	return (uint8_t)__builtin_popcountll(board);
+}
+
+///////////////////////////// game play //////////////////////////////
+
+// recompute the legal move cache for the current player, this must be
+// called every time the game position changes
+static void refresh_turn_moves(void) {
+	bitboard_t own = game.pieces[game.side];
+	bitboard_t opp = game.pieces[game.side ^ 1];
+	turn_moves = generate_moves(own, opp);
 	
-	// and for player 2
-	for (uint8_t i = 0; i < START_PIECES; i++) {
-		uint8_t x = p2_start_pieces[i][0];
-		uint8_t y = p2_start_pieces[i][1];
-		board[x][y] = PLAYER_2;
-		update_square_colour(x, y, PLAYER_2);		
+	bitboard_t moves = turn_moves;
+	for (uint8_t sq = 0; sq < WIDTH * HEIGHT; sq++, moves >>= 1) {
+		if (moves & 1) {
+			flip_counts[sq] = count_bits(compute_flips(own, opp, sq));
+		} else {
+			flip_counts[sq] = 0;
+		}
+	}
+}
+
+// display the turn of players by LED
+static void show_turn(uint8_t player) {
+	if (player == PLAYER_1) {
+		PORTB |= 1 << PORTB0;
+		PORTB &= ~(1 << PORTB1);
+	} else {
+		PORTB |= 1 << PORTB1;
+		PORTB &= ~(1 << PORTB0);
+	}
+}
+
+// remember a move for looking up the opening book
+static void record_move(uint8_t sq) {
+	if (moves_played < BOOK_MAX_PLY) {
+		move_history[moves_played] = sq;
 	}
+	if (moves_played < 0xFF) {
+		moves_played++;
+	}
+}
+
+// bring the display, the scores and the LEDs up to date with a move (the
+// squares and scores are drawn with the next frame)
+static void show_move_result(const move_result_t *result) {
+	render_squares(result->changed, result->player);
+	update_score();
+	show_turn(result->next_player);
+}
+
+void initialise_board(void) {
+	
+	// initialise the display we are using
+	initialise_display();
+	render_init();
+	
+	// set up the starting pieces, player 1 starts
+	init_position(&game);
+	refresh_turn_moves();
+	moves_played = 0;
 	
-	// set the starting player
-	current_player = PLAYER_1;
+	// and show them on the board
+	render_squares(game.pieces[0], PLAYER_1);
+	render_squares(game.pieces[1], PLAYER_2);
 	
 	// also set where the cursor starts
 	cursor_x = CURSOR_X_START;
@@ -65,18 +344,22 @@ void initialise_board(void) {
 	cursor_visible = 0;
 	// the game start from player 1 with red piece
 	DDRB |= (1 << DDB0) | (1 << DDB1);
-	PORTB |= 1 << PORTB0;
-	PORTB &= ~(1 << PORTB1);
+	show_turn(PLAYER_1);
 }
 
 uint8_t get_piece_at(uint8_t x, uint8_t y) {
 	// check the bounds, anything outside the bounds
 	// will be considered empty
-	if (x < 0 || x >= WIDTH || y < 0 || y >= WIDTH) {
+	if (x >= WIDTH || y >= HEIGHT) {
 		return EMPTY_SQUARE;
+	}
+	bitboard_t bit = SQUARE_BIT(SQUARE(x, y));
+	if (game.pieces[0] & bit) {
+		return PLAYER_1;
+	} else if (game.pieces[1] & bit) {
+		return PLAYER_2;
 	} else {
-		//if in the bounds, just index into the array
-		return board[x][y];
+		return EMPTY_SQUARE;
 	}
 }
 
@@ -86,14 +369,14 @@ void flash_cursor(void) {
 		// we need to flash the cursor off, it should be replaced by
 		// the colour of the piece which is at that location
 		uint8_t piece_at_cursor = get_piece_at(cursor_x, cursor_y);
-		update_square_colour(cursor_x, cursor_y, piece_at_cursor);
+		render_cursor_square(cursor_x, cursor_y, piece_at_cursor);
 		
 	} else {
 		// we need to flash the cursor on
 		if (check_valid_place(cursor_x, cursor_y)) {
-			update_square_colour(cursor_x, cursor_y, CURSOR);
+			render_cursor_square(cursor_x, cursor_y, CURSOR);
 		} else {
-			update_square_colour(cursor_x, cursor_y, ILLEGAL_CURSOR);
+			render_cursor_square(cursor_x, cursor_y, ILLEGAL_CURSOR);
 		}
 	}
 	cursor_visible = 1 - cursor_visible; //alternate between 0 and 1
@@ -122,290 +405,69 @@ void move_display_cursor(uint8_t dx, uint8_t dy) {
 	 */
 }
 
-uint8_t distance(uint8_t x, uint8_t y, uint8_t xx, uint8_t yy) {
-	uint8_t dx = abs(x - xx);
-	uint8_t dy = abs(y - yy);
-	if (dx > 0) {
-		return dx;
-	} else {
-		return dy;
-	}
-}
-
 uint8_t check_valid_place(uint8_t x, uint8_t y) {
-	// if the direction is legal direction, 0 is illegal, 1 is legal
-	uint8_t is_valid = 0;
-	uint8_t next_player;
-	if (current_player == PLAYER_1) {
-		next_player = PLAYER_2;
-	} else {
-		next_player = PLAYER_1;
-	}
-	
-	// check the up direction
-	uint8_t x_up = x;
-	uint8_t y_up = y + 1;
-	while (y_up <= 7 && get_piece_at(x_up, y_up) == next_player) {
-		y_up += 1;
-	}
-	if (y_up <= 7 && distance(x, y, x_up, y_up) > 1 && board[x_up][y_up] == current_player) {
-		valid_direction[x][y][0] = 1;
-		is_valid = 1;
-	}
-	
-	// check the up-right direction
-	uint8_t x_up_right = x + 1;
-	uint8_t y_up_right = y + 1;
-	while (x_up_right <= 7 && y_up_right <= 7 && get_piece_at(x_up_right, y_up_right) == next_player) {
-		x_up_right += 1;
-		y_up_right += 1;
-	}
-	if (x_up_right <= 7 && y_up_right <= 7 && distance(x, y, x_up_right, y_up_right) > 1 && board[x_up_right][y_up_right] == current_player) {
-		valid_direction[x][y][1] = 1;
-		is_valid = 1;
-	}
-	
-	// check the right direction
-	uint8_t x_right = x + 1;
-	uint8_t y_right = y;
-	while (x_right <= 7 && get_piece_at(x_right, y_right) == next_player) {
-		x_right += 1;
-	}
-	if (x_right <= 7 && distance(x, y, x_right, y_right) > 1 && board[x_right][y_right] == current_player) {
-		valid_direction[x][y][2] = 1;
-		is_valid = 1;
-	}
-	
-	// check the down-right direction 
-	uint8_t x_down_right = x + 1;
-	uint8_t y_down_right = y - 1;
-	while(x_down_right <= 7 && y_down_right >= 0 && get_piece_at(x_down_right, y_down_right) == next_player) {
-		x_down_right += 1;
-		y_down_right -= 1;
-	}
-	if (x_down_right <= 7 && y_down_right >= 0 && distance(x, y, x_down_right, y_down_right) > 1 && board[x_down_right][y_down_right] == current_player) {
-		valid_direction[x][y][3] = 1;
-		is_valid = 1;
-	}
-	
-	// check the down direction 
-	uint8_t x_down = x;
-	uint8_t y_down = y - 1;
-	while (y_down >= 0 && get_piece_at(x_down, y_down) == next_player) {
-		y_down -= 1;
+	// a placement is valid if the square is one of the current player's
+	// legal moves, 0 is illegal, 1 is legal
+	if (x >= WIDTH || y >= HEIGHT) {
+		return 0;
 	}
-	if (y_down >= 0 && distance(x, y, x_down, y_down) > 1 && board[x_down][y_down] == current_player) {
-		valid_direction[x][y][4] = 1;
-		is_valid = 1;
+	if (turn_moves & SQUARE_BIT(SQUARE(x, y))) {
+		return 1;
 	}
-	
-	// check the down-left direction
-	uint8_t x_down_left = x - 1;
-	uint8_t y_down_left = y - 1;
-	while (x_down_left >= 0 && y_down_left >= 0 && get_piece_at(x_down_left, y_down_left) == next_player) {
-		x_down_left -= 1;
-		y_down_left -= 1;
-	}
-	if (x_down_left >= 0 && y_down_left >= 0 && distance(x, y, x_down_left, y_down_left) > 1 && board[x_down_left][y_down_left] == current_player) {
-		valid_direction[x][y][5] = 1;
-		is_valid = 1;
-	}
-	
-	// check the left direction
-	uint8_t x_left = x - 1;
-	uint8_t y_left = y;
-	while (x_left >= 0 && get_piece_at(x_left, y_left) == next_player) {
-		x_left -= 1;
-	}
-	if (x_left >= 0 && distance(x, y, x_left, y_left) > 1 && board[x_left][y_left] == current_player) {
-		valid_direction[x][y][6] = 1;
-		is_valid = 1;
-	}
-	
-	// check the up-left direction
-	uint8_t x_up_left = x - 1;
-	uint8_t y_up_left = y + 1;
-	while (x_up_left >= 0 && y_up_left <= 7 && get_piece_at(x_up_left, y_up_left) == next_player) {
-		x_up_left -= 1;
-		y_up_left += 1;
-	}
-	if (x_up_left >= 0 && y_up_left <= 7 && distance(x, y, x_up_left, y_up_left) > 1 && board[x_up_left][y_up_left] == current_player) {
-		valid_direction[x][y][7] = 1;
-		is_valid = 1;
-	}
-	return is_valid;
+	return 0;
 }
 
-void flip_piece(uint8_t x, uint8_t y) {
-	uint8_t next_player_for_flip;
-	if (current_player == PLAYER_1) {
-		next_player_for_flip = PLAYER_2;
-	} else {
-		next_player_for_flip = PLAYER_1;
-	}
-	
-	uint8_t x_for_flip;
-	uint8_t y_for_flip;
-	
-	// flip up direction
-	if (valid_direction[x][y][0]) {
-		x_for_flip = x;
-		y_for_flip = y + 1;
-		while (board[x_for_flip][y_for_flip] == next_player_for_flip) {
-			board[x_for_flip][y_for_flip] = current_player;
-			update_square_colour(x_for_flip, y_for_flip, board[x_for_flip][y_for_flip]);
-			flip_piece_score(board[x][y]);
-			y_for_flip++;
-		}
-	}
-	
-	// flip the up-right
-	if (valid_direction[x][y][1]) {
-		x_for_flip = x + 1;
-		y_for_flip = y + 1;
-		while (board[x_for_flip][y_for_flip] == next_player_for_flip) {
-			board[x_for_flip][y_for_flip] = current_player;
-			update_square_colour(x_for_flip, y_for_flip, board[x_for_flip][y_for_flip]);
-			flip_piece_score(board[x][y]);
-			x_for_flip++;
-			y_for_flip++;
-		}
-	}
-	
-	// flip the right direction
-	if (valid_direction[x][y][2]) {
-		x_for_flip = x + 1;
-		y_for_flip = y;
-		while (board[x_for_flip][y_for_flip] == next_player_for_flip) {
-			board[x_for_flip][y_for_flip] = current_player;
-			update_square_colour(x_for_flip, y_for_flip, board[x_for_flip][y_for_flip]);
-			flip_piece_score(board[x][y]);
-			x_for_flip++;
-		}
-	}
-	
-	// flip the down-right direction
-	if (valid_direction[x][y][3]) {
-		x_for_flip = x + 1;
-		y_for_flip = y - 1;
-		while (board[x_for_flip][y_for_flip] == next_player_for_flip) {
-			board[x_for_flip][y_for_flip] = current_player;
-			update_square_colour(x_for_flip, y_for_flip, board[x_for_flip][y_for_flip]);
-			flip_piece_score(board[x][y]);
-			x_for_flip++;
-			y_for_flip--;
-		}
-	}
-	
-	// flip the down direction
-	if (valid_direction[x][y][4]) {
-		x_for_flip = x;
-		y_for_flip = y - 1;
-		while (board[x_for_flip][y_for_flip] == next_player_for_flip) {
-			board[x_for_flip][y_for_flip] = current_player;
-			update_square_colour(x_for_flip, y_for_flip, board[x_for_flip][y_for_flip]);
-			flip_piece_score(board[x][y]);
-			y_for_flip--;
-		}
-	}
-	
-	// flip the down-left direction
-	if (valid_direction[x][y][5]) {
-		x_for_flip = x - 1;
-		y_for_flip = y - 1;
-		while (board[x_for_flip][y_for_flip] == next_player_for_flip) {
-			board[x_for_flip][y_for_flip] = current_player;
-			update_square_colour(x_for_flip, y_for_flip, board[x_for_flip][y_for_flip]);
-			flip_piece_score(board[x][y]);
-			x_for_flip--;
-			y_for_flip--;
-		}
-	}
-	
-	// flip the left direction
-	if (valid_direction[x][y][6]) {
-		x_for_flip = x - 1;
-		y_for_flip = y;
-		while (board[x_for_flip][y_for_flip] == next_player_for_flip) {
-			board[x_for_flip][y_for_flip] = current_player;
-			update_square_colour(x_for_flip, y_for_flip, board[x_for_flip][y_for_flip]);
-			flip_piece_score(board[x][y]);
-			x_for_flip--;
-		}
-	}
-	
-	// flip up-left direction
-	if (valid_direction[x][y][7]) {
-		x_for_flip = x - 1;
-		y_for_flip = y + 1;
-		while(board[x_for_flip][y_for_flip] == next_player_for_flip) {
-			board[x_for_flip][y_for_flip] = current_player;
-			update_square_colour(x_for_flip, y_for_flip, board[x_for_flip][y_for_flip]);
-			flip_piece_score(board[x][y]);
-			x_for_flip--;
-			y_for_flip++;
-		}
+uint8_t get_flip_count(uint8_t x, uint8_t y) {
+	if (x >= WIDTH || y >= HEIGHT) {
+		return 0;
 	}
+	return flip_counts[SQUARE(x, y)];
 }
 
 void piece_placement(void) {
-	// check if the current position of cursor is empty
-	if (get_piece_at(cursor_x, cursor_y) == EMPTY_SQUARE && check_valid_place(cursor_x, cursor_y)){
-		
-		board[cursor_x][cursor_y] = current_player;
-		flip_piece(cursor_x, cursor_y);
-		piece_placement_score(board[cursor_x][cursor_y]);
-		// place the correct piece of each player
-		update_square_colour(cursor_x, cursor_y, board[cursor_x][cursor_y]);
-		
-		
-		// display the turn of players by LED
-		if (current_player == PLAYER_1) {
-			PORTB |= 1 << PORTB1;
-			PORTB &= ~(1 << PORTB0);
-			} else if (current_player == PLAYER_2) {
-			PORTB |= 1 << PORTB0;
-			PORTB &= ~(1 << PORTB1);
-		}
-		
-		// switch play turn of players
-		if (current_player == PLAYER_1) {
-			current_player = PLAYER_2;
-		} else {
-			current_player = PLAYER_1;
-		}
+	// only empty squares are ever legal moves, so this also checks
+	// that the current position of the cursor is empty
+	if (check_valid_place(cursor_x, cursor_y)) {
+		place_piece(SQUARE(cursor_x, cursor_y));
+	}
+}
 		
-		// check if there is available move for players, if not, game over
-		if (!check_available_move(current_player)) {
-			if (current_player == PLAYER_1) {
-				current_player = PLAYER_2;
-				PORTB |= 1 << PORTB1;
-				PORTB &= ~(1 << PORTB0);
-				if (! check_available_move(current_player)) {
-					no_move_game_over = 1;
-				} 
-			} else {
-				current_player = PLAYER_1;
-				PORTB |= 1 << PORTB0;
-				PORTB &= ~(1 << PORTB1);
-				if (! check_available_move(current_player)) {
-					no_move_game_over = 1;
-				}
-			}
-		} 
+void place_piece(uint8_t sq) {
+	// make the move (passing for the next player if they have to),
+	// then show everything that changed
+	move_result_t result = apply_move(&game, sq);
+	refresh_turn_moves();
+	record_move(sq);
+	if (result.passed) {
+		record_move(PASS_MOVE);
+	}
+	show_move_result(&result);
+
+	// if neither player can move, game over
+	if (result.game_over) {
+		no_move_game_over = 1;
 	}
 }
 
+const position_t *get_game_position(void) {
+	return &game;
+}
+
+uint8_t get_book_move(void) {
+	// once the game has left the book it can never come back
+	if (moves_played >= BOOK_MAX_PLY) {
+		return NO_BOOK_MOVE;
+	}
+	return book_lookup(move_history, moves_played);
+}
+
 uint8_t check_available_move(uint8_t player) {
-	// check every place of board
-	for (int i = 0; i <= 7; i++) {
-		for (int j = 0; j <= 7; j++) {
-			if (get_piece_at(i, j) == EMPTY_SQUARE && check_valid_place(i, j)) {
-				return 1;
-			}
-		}
+	// the current player's moves are already known
+	if (player == get_current_player()) {
+		return turn_moves != 0;
 	}
-	return 0;
+	bitboard_t own = game.pieces[player - PLAYER_1];
+	return generate_moves(own, game.pieces[0] ^ game.pieces[1] ^ own) != 0;
 }
 
 uint8_t no_available_move_game_over(void) {
@@ -414,14 +476,9 @@ uint8_t no_available_move_game_over(void) {
 
 uint8_t is_game_over(void) {
 	// The game ends when every single square is filled
-	// Check for any squares that are empty
-	for (uint8_t x = 0; x < WIDTH; x++) {
-		for (uint8_t y = 0; y < HEIGHT; y++) {
-			if (board[x][y] == EMPTY_SQUARE) {
-				// there was an empty square, game is not over
-				return 0;
-			}
-		}
+	if (~(game.pieces[0] | game.pieces[1])) {
+		// there was an empty square, game is not over
+		return 0;
 	}
 	// if we don't clear this variable, the game can't restart normally.
 	no_move_game_over = 0;
@@ -430,10 +487,14 @@ uint8_t is_game_over(void) {
 	return 1;
 }
 
+uint8_t get_piece_count(uint8_t player) {
+	return count_bits(game.pieces[player - PLAYER_1]);
+}
+
 uint8_t get_current_player(void) {
-	if (current_player == PLAYER_1) {
+	if (game.side == 0) {
 		return PLAYER_1;
 	} else {
 		return PLAYER_2;
 	}
-}
\ No newline at end of file
+}
@@ -11,6 +11,103 @@
 
 #include <inttypes.h>
 
+// the board is held as one 64 bit occupancy mask per player, bit
+// (y * WIDTH + x) being set means that player has a piece at (x,y)
+typedef uint64_t bitboard_t;
+
+#define SQUARE(x, y)	((y) * 8 + (x))
+#define SQUARE_X(sq)	((sq) & 7)
+#define SQUARE_Y(sq)	((sq) >> 3)
+#define SQUARE_BIT(sq)	((bitboard_t)1 << (sq))
+
+// the move made by a player who has no legal move but whose opponent does
+#define PASS_MOVE		64
+
+/////////////////////////////// engine ///////////////////////////////
+// The functions in this section only work on the position they are
+// given, they never touch the display, the scores or the LEDs. This
+// means they can be used on scratch positions (e.g. for searching).
+
+// The working state of the computer player (search.c, ttable.c and
+// endgame.c) is declared with this. A multi-threaded host program
+// defines it as __thread so each thread gets its own copy (see
+// host/tournament.c), otherwise it is empty
+#ifndef ENGINE_TLS
+#define ENGINE_TLS
+#endif
+
+// Zobrist hash of a position. 32 bits is plenty for the small tables
+// that fit on the AVR, a host build gets the full 64 bits
+#ifdef __AVR__
+typedef uint32_t zobrist_t;
+#else
+typedef uint64_t zobrist_t;
+#endif
+
+// a game position, the pieces of both players and whose turn it is
+typedef struct {
+	bitboard_t pieces[2];	// pieces[0] for PLAYER_1, pieces[1] for PLAYER_2
+	uint8_t side;			// 0 if PLAYER_1 is to move, 1 if PLAYER_2 is
+	zobrist_t hash;			// kept up to date by make_move()/unmake_move()
+} position_t;
+
+// what make_move() changed, unmake_move() uses this to take the move back
+typedef struct {
+	bitboard_t flipped;
+	zobrist_t hash;			// the hash of the position before the move
+	uint8_t square;
+} undo_t;
+
+// the result of a move being applied to the game, this lists everything
+// that needs to be shown once the move has been made
+typedef struct {
+	bitboard_t changed;		// the placed piece and all the flipped pieces
+	uint8_t square;			// where the piece was placed
+	uint8_t player;			// who placed it
+	uint8_t next_player;	// whose turn it is now (after any forced pass)
+	uint8_t passed;			// 1 if next_player moves again as the other passed
+	uint8_t game_over;		// 1 if neither player can move any more
+} move_result_t;
+
+// set up the starting position
+void init_position(position_t *pos);
+
+// returns the set of squares on which 'own' may legally play against 'opp'
+bitboard_t generate_moves(bitboard_t own, bitboard_t opp);
+
+// returns the set of 'opp' pieces flipped when 'own' plays on square sq
+bitboard_t compute_flips(bitboard_t own, bitboard_t opp, uint8_t sq);
+
+// returns the legal moves of the player to move
+bitboard_t legal_moves(const position_t *pos);
+
+// plays square sq (which must be legal, or PASS_MOVE) for the player to
+// move and hands the turn over, the record returned can be given to
+// unmake_move() to restore the position
+undo_t make_move(position_t *pos, uint8_t sq);
+
+// takes back the move which returned this undo record
+void unmake_move(position_t *pos, const undo_t *undo);
+
+// returns 1 if the player to move has no legal move but the opponent does
+uint8_t must_pass(const position_t *pos);
+
+// returns 1 if neither player has a legal move
+uint8_t position_game_over(const position_t *pos);
+
+// plays a legal move and then, if the next player cannot move, passes
+// for them. Returns what changed
+move_result_t apply_move(position_t *pos, uint8_t sq);
+
+// returns the number of set bits in a bitboard
+uint8_t count_bits(bitboard_t board);
+
+// works out the Zobrist hash of a position from scratch (make_move()
+// keeps pos->hash up to date incrementally)
+zobrist_t compute_hash(const position_t *pos);
+
+///////////////////////////// game play //////////////////////////////
+
 // initialise the display of the board, this creates the internal board
 // and also updates the display of the board
 void initialise_board(void);
@@ -30,19 +127,29 @@ void flash_cursor(void);
 // the cursor should be displayed after it is moved as well
 void move_display_cursor(uint8_t dx, uint8_t dy);
 
-// get the distance between two valid piece
-uint8_t distance(uint8_t x, uint8_t y, uint8_t xx, uint8_t yy);
-
-// check if the piece placement is valid
+// check if the piece placement is valid for the current player
+// (this is a lookup into the legal moves found at the start of the turn)
 uint8_t check_valid_place(uint8_t x, uint8_t y);
 
-// flip piece in terms of legal move
-void flip_piece(uint8_t x, uint8_t y);
+// returns how many pieces the current player would flip by placing at
+// (x,y), 0 if that is not a legal move
+uint8_t get_flip_count(uint8_t x, uint8_t y);
 
 // A piece can be placed at the current location of the cursor when button B0
 // or space bar is pressed
 void piece_placement(void);
 
+// places a piece for the current player on square sq, which must be one
+// of their legal moves, and updates the display, scores and LEDs
+void place_piece(uint8_t sq);
+
+// returns the position of the game being played
+const position_t *get_game_position(void);
+
+// returns the opening book's move for the current player, or
+// NO_BOOK_MOVE (see book.h) if the game is no longer in the book
+uint8_t get_book_move(void);
+
 // check if existing available move
 uint8_t check_available_move(uint8_t player);
 
@@ -55,5 +162,7 @@ uint8_t is_game_over(void);
 // return the current player
 uint8_t get_current_player(void);
 
-#endif
+// returns the number of pieces that player has on the board
+uint8_t get_piece_count(uint8_t player);
 
+#endif
@@ -0,0 +1,47 @@
+/*
+ * host/bench_main.c
+ *
+ * Runs the benchmarks from bench.c on the host, where they can be timed
+ * and profiled (with perf or callgrind, say) at the host's own speed.
+ * The results are printed to stdout.
+ *
+ * Usage: bench [perft|endgame|tt|render|serial]   (all are run if none is given)
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "serialio.h"
+#include "timer0.h"
+#include "timer1.h"
+
+int main(int argc, char **argv) {
+	const char *which = (argc > 1) ? argv[1] : "";
+	if (*which && strcmp(which, "perft") && strcmp(which, "endgame")
+			&& strcmp(which, "tt") && strcmp(which, "render")
+			&& strcmp(which, "serial")) {
+		fprintf(stderr, "usage: %s [perft|endgame|tt|render|serial]\n", argv[0]);
+		return 2;
+	}
+
+	init_serial_stdio(19200, 0);
+	init_timer0();
+	init_timer1();
+	if (!*which || !strcmp(which, "perft")) {
+		run_perft_benchmark();
+	}
+	if (!*which || !strcmp(which, "endgame")) {
+		run_endgame_benchmark();
+	}
+	if (!*which || !strcmp(which, "tt")) {
+		run_tt_benchmark();
+	}
+	if (!*which || !strcmp(which, "render")) {
+		run_render_benchmark();
+	}
+	if (!*which || !strcmp(which, "serial")) {
+		run_serial_benchmark();
+	}
+	return 0;
+}
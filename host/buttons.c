@@ -0,0 +1,38 @@
+/*
+ * host/buttons.c
+ *
+ * Host replacement for buttons.c. There are no push buttons, the host
+ * serial module turns the keys 0 to 2 into pushes of B0 to B2 instead.
+ * A key is a push and an immediate release, queued as the sampling in
+ * timer 0's interrupt queues real ones (see buttons_sample() and
+ * button_events.c).
+ */
+
+#include <stdint.h>
+
+#include "buttons.h"
+#include "button_events.h"
+#include "hal.h"
+#include "idle.h"
+#include "timer0.h"
+
+void init_button_interrupts(void) {
+	button_events_init();
+}
+
+void host_button_press(uint8_t button) {
+	uint32_t now = get_current_time();
+	button_post_press(button, now);
+	button_post_release(button, now);
+	idle_post(IDLE_BUTTON);
+}
+
+void buttons_poll(void) {
+	// pushes arrive with the serial input, so look for some
+	host_poll_input();
+}
+
+uint8_t button_is_down(uint8_t button) {
+	(void)button;
+	return 0;
+}
@@ -0,0 +1,13 @@
+/*
+ * hal.c
+ *
+ * The I/O registers declared by host/include/avr/io.h. Nothing is wired
+ * to them, they just hold the last value written.
+ */
+
+#include <avr/io.h>
+
+volatile uint8_t PINB, DDRB, PORTB;
+volatile uint8_t PINC, DDRC, PORTC;
+volatile uint8_t PIND, DDRD, PORTD;
+volatile uint8_t SREG;
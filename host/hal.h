@@ -0,0 +1,29 @@
+/*
+ * hal.h
+ *
+ * Glue between the host replacements for the hardware modules
+ * (serialio, timer0, timer1 and buttons) when the game is built to run
+ * on a workstation.
+ */
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <stdint.h>
+
+// the keys on the terminal which stand in for push buttons B0 to B2
+#define HOST_BUTTON_KEY_FIRST '0'
+#define HOST_BUTTON_KEY_LAST '2'
+
+// queue a push of the given button (0 to 2), as buttons_sample() does
+// from timer 0's interrupt on the board
+void host_button_press(uint8_t button);
+
+// take in any keys typed on the terminal without waiting
+void host_poll_input(void);
+
+// stands in for the CPU sleeping (see include/avr/sleep.h): waits for a
+// key for up to a millisecond
+void host_sleep(void);
+
+#endif /* HAL_H_ */
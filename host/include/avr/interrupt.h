@@ -0,0 +1,19 @@
+/*
+ * avr/interrupt.h (host build)
+ *
+ * There are no interrupts on the host. cli() and sei() only keep the I
+ * flag in SREG up to date so code which saves and restores it behaves as
+ * it does on the AVR. Interrupt handlers compile to ordinary functions.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define cli() (SREG &= (uint8_t)~_BV(SREG_I))
+#define sei() (SREG |= _BV(SREG_I))
+
+#define ISR(vector) void vector(void)
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
@@ -0,0 +1,64 @@
+/*
+ * avr/io.h (host build)
+ *
+ * Stands in for the avr-libc header when the game is built to run on a
+ * workstation. The I/O registers the game sources touch are plain
+ * variables (defined in host/hal.c), so writes to ports simply land in
+ * memory and reads return whatever was last written.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+// general purpose I/O
+extern volatile uint8_t PINB, DDRB, PORTB;
+extern volatile uint8_t PINC, DDRC, PORTC;
+extern volatile uint8_t PIND, DDRD, PORTD;
+
+// status register, only the global interrupt flag is used
+extern volatile uint8_t SREG;
+#define SREG_I 7
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+
+// bit numbers within the ports
+#define PORTB0 0
+#define PORTB1 1
+#define PORTB2 2
+#define PORTB3 3
+#define PORTB4 4
+#define PORTB5 5
+#define PORTB6 6
+#define PORTB7 7
+#define PORTC0 0
+#define PORTC1 1
+#define PORTC2 2
+#define PORTC3 3
+#define PORTC4 4
+#define PORTC5 5
+#define PORTD2 2
+#define PORTD3 3
+#define PORTD4 4
+#define PORTD5 5
+#define PORTD6 6
+#define PORTD7 7
+#define DDB0 0
+#define DDB1 1
+#define DDB2 2
+#define DDB3 3
+#define DDB4 4
+#define DDB5 5
+#define DDC0 0
+#define DDC1 1
+#define DDC2 2
+#define DDC3 3
+#define PINC0 0
+#define PINC1 1
+#define PINC2 2
+#define PINC3 3
+
+#endif /* HOST_AVR_IO_H_ */
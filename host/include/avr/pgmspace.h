@@ -0,0 +1,37 @@
+/*
+ * avr/pgmspace.h (host build)
+ *
+ * The host has one address space, so data "in flash" is ordinary const
+ * data and the _P functions are the ordinary ones.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_ptr(address) (*(void * const *)(address))
+
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define printf_P printf
+#define fprintf_P fprintf
+#define vfprintf_P vfprintf
+#define vsnprintf_P vsnprintf
+#define fputs_P fputs
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,22 @@
+/*
+ * avr/sleep.h (host build)
+ *
+ * There is no sleep mode on the host. sleep_cpu() waits a millisecond for
+ * input instead (see host_sleep() in hal.h), as the board's CPU sleeps
+ * until the next interrupt, which is never more than a millisecond away.
+ */
+
+#ifndef HOST_AVR_SLEEP_H_
+#define HOST_AVR_SLEEP_H_
+
+#define SLEEP_MODE_IDLE 0
+
+void host_sleep(void);
+
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu() host_sleep()
+#define sleep_mode() host_sleep()
+
+#endif /* HOST_AVR_SLEEP_H_ */
@@ -0,0 +1,24 @@
+/*
+ * util/delay.h (host build)
+ *
+ * Busy waits become sleeps. (<unistd.h> is kept out of this header as
+ * it declares names such as pause() which the game uses for its own
+ * variables.)
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+#include <time.h>
+
+static inline void host_delay_us(double us) {
+	struct timespec delay;
+	delay.tv_sec = (time_t)(us / 1000000);
+	delay.tv_nsec = (long)((us - delay.tv_sec * 1000000.0) * 1000);
+	nanosleep(&delay, 0);
+}
+
+#define _delay_ms(ms) host_delay_us((ms) * 1000.0)
+#define _delay_us(us) host_delay_us(us)
+
+#endif /* HOST_UTIL_DELAY_H_ */
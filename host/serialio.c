@@ -0,0 +1,344 @@
+/*
+ * FILE: host/serialio.c
+ *
+ * Host replacement for serialio.c. The terminal the program runs in
+ * stands in for the serial port: stdout is the transmit side and the
+ * keyboard (or whatever is piped into stdin) the receive side.
+ *
+ * Output goes through an unbuffered stream which counts the bytes as the
+ * board's serial port would send them (each \n as \r\n) the moment they
+ * are printed, and collects them in a buffer of its own. That is written
+ * to the real standard output when the program would wait (sleeping, or
+ * reading input which hasn't come), when serial_flush() is called, and
+ * at least every millisecond while input is being looked for, much as
+ * the board's port sends the bytes while the program carries on. Input is read without waiting for a newline or echoing (the
+ * terminal is put into raw mode while the program runs) and is held in a
+ * buffer, as the receive interrupt does on the board. stdin is then
+ * replaced by a stream which reads from that buffer so fgetc(stdin) and
+ * serial_input_available() agree with each other.
+ *
+ * Input is only read while the buffer has room for it, the rest waits in
+ * the operating system (which stops the sender when its own buffers are
+ * full), so none is lost however fast it is sent.
+ *
+ * The keys 0, 1 and 2 are taken to be push buttons B0 to B2 rather than
+ * serial input. When the input ends (the end of a piped file, or ^D)
+ * the program exits.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serialio.h"
+#include "baud.h"
+#include "hal.h"
+#include "idle.h"
+#include "timer0.h"
+
+/* Circular buffer to hold incoming characters, as on the board. It is
+ * no larger, so that with the button queue there are never more than 128
+ * events waiting and their stamps (see idle_next_sequence()) can be
+ * told apart.
+ */
+#define INPUT_BUFFER_SIZE 64
+static char input_buffer[INPUT_BUFFER_SIZE];
+static uint8_t input_sequence[INPUT_BUFFER_SIZE];
+static uint16_t input_insert_pos;
+static uint16_t bytes_in_input_buffer;
+
+static int8_t do_echo;
+
+/* Whether input is taken as it is (see serial_set_binary()) */
+static uint8_t binary_mode;
+
+/* The rate the board would be using. It makes no difference here. */
+static uint32_t current_baudrate;
+
+static uint32_t bytes_sent;
+
+/* Output which has been counted but not yet written to the terminal, and
+ * the time it was last written out
+ */
+#define OUTPUT_BUFFER_SIZE 4096
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static size_t output_length;
+static uint32_t output_time;
+
+/* Terminal settings to put back when the program exits */
+static struct termios saved_termios;
+static uint8_t terminal_is_raw;
+
+static ssize_t host_read(void *cookie, char *buffer, size_t size);
+static ssize_t host_write(void *cookie, const char *buffer, size_t size);
+static void write_output(void);
+
+static void restore_terminal(void) {
+	write_output();
+	if (terminal_is_raw) {
+		tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+		terminal_is_raw = 0;
+	}
+}
+
+static void exit_on_signal(int signal_number) {
+	(void)signal_number;
+	restore_terminal();
+	_exit(1);
+}
+
+void init_serial_stdio(long baudrate, int8_t echo) {
+	current_baudrate = baudrate;
+	input_insert_pos = 0;
+	bytes_in_input_buffer = 0;
+	do_echo = echo;
+
+	/* Deliver each key as it is typed, without echo */
+	if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved_termios) == 0) {
+		struct termios raw = saved_termios;
+		raw.c_lflag &= ~(ICANON | ECHO);
+		raw.c_cc[VMIN] = 1;
+		raw.c_cc[VTIME] = 0;
+		tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+		terminal_is_raw = 1;
+	}
+	atexit(restore_terminal);
+	signal(SIGINT, exit_on_signal);
+	signal(SIGTERM, exit_on_signal);
+
+	/* Read stdin through our buffer, and count what is written as it is
+	 * written (so stdout has no buffer of its own)
+	 */
+	cookie_io_functions_t input_functions = { .read = host_read };
+	FILE *stream = fopencookie(NULL, "r", input_functions);
+	if (stream) {
+		setvbuf(stream, NULL, _IONBF, 0);
+		stdin = stream;
+	}
+	cookie_io_functions_t output_functions = { .write = host_write };
+	fflush(stdout);
+	stream = fopencookie(NULL, "w", output_functions);
+	if (stream) {
+		setvbuf(stream, NULL, _IONBF, 0);
+		stdout = stream;
+	}
+}
+
+/* Count the bytes written as they would be sent */
+static uint32_t count_bytes(const char *start, const char *end) {
+	uint32_t count = 0;
+	for (const char *c = start; c < end; c++) {
+		count += (*c == '\n') ? 2 : 1;
+	}
+	return count;
+}
+
+/* Write out everything printed so far */
+static void write_output(void) {
+	size_t done = 0;
+	while (done < output_length) {
+		ssize_t written = write(STDOUT_FILENO, output_buffer + done,
+				output_length - done);
+		if (written <= 0) {
+			break;
+		}
+		done += written;
+	}
+	output_length = 0;
+	output_time = get_current_time();
+}
+
+void serial_flush(void) {
+	write_output();
+}
+
+void serial_set_baud(uint32_t baudrate) {
+	serial_flush();
+	current_baudrate = baudrate;
+}
+
+uint32_t serial_get_baud(void) {
+	return current_baudrate;
+}
+
+uint32_t serial_bytes_sent(void) {
+	return bytes_sent;
+}
+
+void serial_put_byte(char c) {
+	/* Through stdout so it stays in order with printed output (the
+	 * game only prints from one thread, so the stream's lock is not
+	 * needed)
+	 */
+	putc_unlocked(c, stdout);
+}
+
+uint8_t serial_tx_free(void) {
+	/* Writes to the terminal never back up, so report the buffer as
+	 * empty as the board's would be (it holds 255 bytes).
+	 */
+	return 255;
+}
+
+uint8_t serial_tx_headroom(uint8_t priority) {
+	uint8_t free = serial_tx_free();
+	if (priority == SERIAL_PRIORITY_HIGH) {
+		return free;
+	}
+	return free - SERIAL_TX_RESERVE;
+}
+
+uint8_t serial_write_nonblocking(const char *data, uint8_t length) {
+	fwrite(data, 1, length, stdout);
+	return length;
+}
+
+void serial_write(const void *data, uint16_t length) {
+	fwrite(data, 1, length, stdout);
+}
+
+void serial_write_P(PGM_P data, uint16_t length) {
+	fwrite(data, 1, length, stdout);
+}
+
+static ssize_t host_write(void *cookie, const char *buffer, size_t size) {
+	(void)cookie;
+	bytes_sent += count_bytes(buffer, buffer + size);
+	size_t done = 0;
+	while (done < size) {
+		if (output_length == OUTPUT_BUFFER_SIZE) {
+			write_output();
+		}
+		size_t length = size - done;
+		if (length > OUTPUT_BUFFER_SIZE - output_length) {
+			length = OUTPUT_BUFFER_SIZE - output_length;
+		}
+		memcpy(output_buffer + output_length, buffer + done, length);
+		output_length += length;
+		done += length;
+	}
+	return size;
+}
+
+/* Take one character into the input buffer (or the button queue). The
+ * digits of a baud rate request (from SYN to the CR, see baud.h) are not
+ * button presses, and nor is anything in binary mode.
+ */
+static void receive_char(char c) {
+	static int in_request = 0;
+	if (!binary_mode) {
+		if (c == BAUD_SYN) {
+			in_request = 1;
+		} else if (c == '\r') {
+			in_request = 0;
+		}
+		if (!in_request && c >= HOST_BUTTON_KEY_FIRST && c <= HOST_BUTTON_KEY_LAST) {
+			host_button_press(c - HOST_BUTTON_KEY_FIRST);
+			return;
+		}
+		if (do_echo) {
+			putchar(c);
+		}
+		if (c == '\r') {
+			c = '\n';
+		}
+	}
+	input_sequence[input_insert_pos] = idle_next_sequence();
+	input_buffer[input_insert_pos++] = c;
+	bytes_in_input_buffer++;
+	if (input_insert_pos == INPUT_BUFFER_SIZE) {
+		input_insert_pos = 0;
+	}
+	idle_post(IDLE_SERIAL);
+}
+
+/* Read whatever has been typed, waiting up to timeout_ms milliseconds
+ * (forever if negative) for the first character.
+ */
+static void read_input(int timeout_ms) {
+	struct pollfd input = { .fd = STDIN_FILENO, .events = POLLIN };
+	while (bytes_in_input_buffer < INPUT_BUFFER_SIZE
+			&& poll(&input, 1, timeout_ms) > 0) {
+		char c;
+		if (read(STDIN_FILENO, &c, 1) != 1) {
+			/* End of the input */
+			exit(0);
+		}
+		receive_char(c);
+		timeout_ms = 0;
+	}
+}
+
+void host_poll_input(void) {
+	/* Anything printed more than a millisecond ago should be seen, in
+	 * case a reply to it is being waited for. Output printed since then
+	 * is kept back so that a frame goes out in one piece.
+	 */
+	if (output_length && get_current_time() != output_time) {
+		write_output();
+	}
+	read_input(0);
+}
+
+void host_sleep(void) {
+	/* The board's CPU is woken at least every millisecond, by timer 0 */
+	write_output();
+	read_input(1);
+}
+
+int8_t serial_input_available(void) {
+	host_poll_input();
+	return (bytes_in_input_buffer != 0);
+}
+
+uint8_t serial_input_sequence(uint8_t *sequence) {
+	if (bytes_in_input_buffer == 0) {
+		return 0;
+	}
+	int16_t pos = input_insert_pos - bytes_in_input_buffer;
+	if (pos < 0) {
+		pos += INPUT_BUFFER_SIZE;
+	}
+	*sequence = input_sequence[pos];
+	return 1;
+}
+
+void serial_set_binary(uint8_t binary) {
+	binary_mode = binary;
+}
+
+void serial_get_rx_stats(serial_rx_stats_t *stats) {
+	/* Nothing is ever lost */
+	stats->overruns = 0;
+	stats->dropped = 0;
+}
+
+void clear_serial_input_buffer(void) {
+	input_insert_pos = 0;
+	bytes_in_input_buffer = 0;
+}
+
+static ssize_t host_read(void *cookie, char *buffer, size_t size) {
+	(void)cookie;
+	write_output();
+	/* Wait until we've received a character */
+	while (bytes_in_input_buffer == 0) {
+		read_input(-1);
+	}
+	size_t count = 0;
+	while (count < size && bytes_in_input_buffer != 0) {
+		int16_t pos = input_insert_pos - bytes_in_input_buffer;
+		if (pos < 0) {
+			pos += INPUT_BUFFER_SIZE;
+		}
+		buffer[count++] = input_buffer[pos];
+		bytes_in_input_buffer--;
+	}
+	return count;
+}
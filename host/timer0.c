@@ -0,0 +1,58 @@
+/*
+ * host/timer0.c
+ *
+ * Host replacement for timer0.c. The millisecond clock is read from the
+ * operating system's monotonic clock. As on the board the clock stands
+ * still while the game is paused. There is no seven segment display, so
+ * set_seven_seg_number() only remembers the number.
+ */
+
+#include <stdint.h>
+#include <time.h>
+#include <avr/io.h>
+
+#include "timer0.h"
+
+// milliseconds of monotonic time at which the clock read 0
+static uint64_t start_ms;
+// the number the seven segment display would show
+static uint8_t seven_seg_number;
+// if the game is paused, the clock reading when it was
+static uint8_t pause_state;
+static uint32_t paused_at;
+
+static uint64_t monotonic_ms(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void init_timer0(void) {
+	start_ms = monotonic_ms();
+	pause_state = 0;
+	DDRB |= 0x38;
+	DDRC |= (1 << DDC3);
+	DDRD |= 0xFC;
+}
+
+uint32_t get_current_time(void) {
+	if (pause_state) {
+		return paused_at;
+	}
+	return (uint32_t)(monotonic_ms() - start_ms);
+}
+
+void set_seven_seg_number(uint8_t number) {
+	seven_seg_number = number;
+}
+
+void pause_game(void) {
+	if (pause_state == 0) {
+		paused_at = get_current_time();
+		pause_state = 1;
+	} else {
+		// carry on from where the clock stopped
+		start_ms = monotonic_ms() - paused_at;
+		pause_state = 0;
+	}
+}
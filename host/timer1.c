@@ -0,0 +1,32 @@
+/*
+ * host/timer1.c
+ *
+ * Host replacement for timer1.c. Cycle counts are worked out from the
+ * operating system's monotonic clock as the number of cycles a 16MHz
+ * AVR would have run in the same time, so that code which turns cycle
+ * counts into times keeps working. They are not the host's own cycles.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#include "timer1.h"
+
+// cycles of the AVR's clock per microsecond
+#define CYCLES_PER_US 16
+
+static uint64_t start_ns;
+
+static uint64_t monotonic_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void init_timer1(void) {
+	start_ns = monotonic_ns();
+}
+
+uint32_t get_cycle_count(void) {
+	return (uint32_t)((monotonic_ns() - start_ns) * CYCLES_PER_US / 1000);
+}
@@ -0,0 +1,378 @@
+/*
+ * host/tournament.c
+ *
+ * Plays the computer player against itself on the host, many games at
+ * once, to compare two settings of the engine.
+ *
+ * Usage: tournament [-g games] [-j threads] [-a player] [-b player]
+ *                   [-r random_plies] [-s seed] [-o record_file]
+ *
+ * A player is TIME_MS or TIME_MS/DEPTH: the time budget for each move in
+ * milliseconds and, optionally, the deepest iteration the search may run
+ * (see search_set_depth_limit()). Games are played in pairs from the
+ * same opening, A playing first in one and second in the other. The
+ * opening of each pair is random_plies random legal moves from the
+ * start.
+ *
+ * The games are shared out between the threads (one per core by
+ * default) on a work-stealing pool: each thread has its own queue of
+ * games and, once that is empty, takes games from the back of the other
+ * threads' queues. Each thread has its own copy of the engine's state
+ * (ENGINE_TLS), including a transposition table.
+ *
+ * At the end A's score against B is given along with the Elo difference
+ * it implies and a 95% confidence interval, the games played per second
+ * and statistics on the time taken by each player's moves.
+ *
+ * The record file holds the header "RVG1" followed by one record per
+ * game, in the order the games finished:
+ *
+ *     uint32_t  game number (little-endian)
+ *     uint8_t   flags: bit 0 set if A played first (as PLAYER_1)
+ *     uint8_t   number of random opening moves
+ *     uint8_t   PLAYER_1's pieces at the end
+ *     uint8_t   PLAYER_2's pieces at the end
+ *     uint8_t   number of moves, n
+ *     uint8_t   the n moves, squares as in game.h (PASS_MOVE for a pass)
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "search.h"
+#include "timer0.h"
+
+// the most moves a game can have, passes included
+#define MAX_GAME_MOVES 128
+
+typedef struct {
+	uint16_t time_ms;
+	uint8_t depth;		// 0 for no limit
+} player_t;
+
+// per-move timings of one player
+typedef struct {
+	uint64_t moves;
+	double total_ms;
+	double total_squared_ms;
+	double max_ms;
+	uint64_t total_depth;
+} move_stats_t;
+
+typedef struct {
+	uint32_t wins, draws, losses;	// from A's point of view
+	move_stats_t players[2];		// A, B
+} tally_t;
+
+// a thread's queue of games, taken from the front by its owner and from
+// the back by other threads
+typedef struct {
+	pthread_mutex_t lock;
+	uint32_t *games;
+	uint32_t front, back;
+} work_queue_t;
+
+typedef struct {
+	uint32_t games;
+	uint32_t threads;
+	player_t players[2];
+	uint8_t random_plies;
+	uint32_t seed;
+	const char *record_path;
+} options_t;
+
+static options_t options = {
+	.games = 200,
+	.threads = 0,
+	.players = { { 20, 0 }, { 20, 0 } },
+	.random_plies = 6,
+	.seed = 1,
+	.record_path = 0
+};
+
+static work_queue_t *queues;
+
+static pthread_mutex_t results_lock = PTHREAD_MUTEX_INITIALIZER;
+static tally_t results;
+static FILE *record_file;
+static uint32_t games_done;
+
+static double now_ms(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+// small random number generator (xorshift) so openings can be repeated
+static uint32_t next_random(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+// plays random moves from the start, returns the number of moves made or
+// 0 if the game ended (try again with the changed random state)
+static uint8_t random_opening(position_t *pos, uint8_t *moves, uint32_t *random) {
+	init_position(pos);
+	for (uint8_t ply = 0; ply < options.random_plies; ply++) {
+		bitboard_t legal = legal_moves(pos);
+		if (!legal) {
+			return 0;
+		}
+		for (uint32_t skip = next_random(random) % count_bits(legal); skip; skip--) {
+			legal &= legal - 1;
+		}
+		moves[ply] = (uint8_t)__builtin_ctzll(legal);
+		make_move(pos, moves[ply]);
+	}
+	return legal_moves(pos) ? options.random_plies : 0;
+}
+
+static void add_move_time(move_stats_t *stats, double ms, uint8_t depth) {
+	stats->moves++;
+	stats->total_ms += ms;
+	stats->total_squared_ms += ms * ms;
+	if (ms > stats->max_ms) {
+		stats->max_ms = ms;
+	}
+	stats->total_depth += depth;
+}
+
+static void merge_move_stats(move_stats_t *into, const move_stats_t *from) {
+	into->moves += from->moves;
+	into->total_ms += from->total_ms;
+	into->total_squared_ms += from->total_squared_ms;
+	if (from->max_ms > into->max_ms) {
+		into->max_ms = from->max_ms;
+	}
+	into->total_depth += from->total_depth;
+}
+
+static void write_record(uint32_t game, uint8_t a_first, uint8_t opening_plies,
+		const position_t *pos, const uint8_t *moves, uint8_t count) {
+	uint8_t header[9] = {
+		game & 0xFF, (game >> 8) & 0xFF, (game >> 16) & 0xFF, game >> 24,
+		a_first, opening_plies, count_bits(pos->pieces[0]),
+		count_bits(pos->pieces[1]), count
+	};
+	fwrite(header, 1, sizeof(header), record_file);
+	fwrite(moves, 1, count, record_file);
+}
+
+static void play_game(uint32_t game) {
+	// both games of a pair start from the same opening
+	uint32_t random = options.seed * 2654435761u + (game / 2) * 40503u + 1;
+	uint8_t a_side = game & 1;		// A is PLAYER_1 in even games
+	uint8_t moves[MAX_GAME_MOVES];
+	position_t pos;
+	uint8_t count;
+	while ((count = random_opening(&pos, moves, &random)) == 0 && options.random_plies) {
+		// the random moves ended the game, try another opening
+	}
+	uint8_t opening_plies = count;
+
+	move_stats_t stats[2];
+	memset(stats, 0, sizeof(stats));
+	search_new_game();
+	while (!position_game_over(&pos) && count < MAX_GAME_MOVES) {
+		uint8_t move = PASS_MOVE;
+		if (legal_moves(&pos)) {
+			uint8_t player = (pos.side == a_side) ? 0 : 1;
+			search_set_depth_limit(options.players[player].depth);
+			double start = now_ms();
+			search_result_t result = search_best_move(&pos, options.players[player].time_ms);
+			add_move_time(&stats[player], now_ms() - start, result.depth);
+			move = result.best_move;
+		}
+		make_move(&pos, move);
+		moves[count++] = move;
+	}
+
+	int a_pieces = count_bits(pos.pieces[a_side]);
+	int b_pieces = count_bits(pos.pieces[a_side ^ 1]);
+
+	pthread_mutex_lock(&results_lock);
+	if (a_pieces > b_pieces) {
+		results.wins++;
+	} else if (a_pieces < b_pieces) {
+		results.losses++;
+	} else {
+		results.draws++;
+	}
+	merge_move_stats(&results.players[0], &stats[0]);
+	merge_move_stats(&results.players[1], &stats[1]);
+	if (record_file) {
+		write_record(game, a_side == 0, opening_plies, &pos, moves, count);
+	}
+	games_done++;
+	if (isatty(STDERR_FILENO)) {
+		fprintf(stderr, "\r%u/%u games", games_done, options.games);
+	}
+	pthread_mutex_unlock(&results_lock);
+}
+
+// takes a game from the front of a thread's own queue, or failing that
+// from the back of another thread's. Returns 0 when there are none left
+static int take_game(uint32_t thread, uint32_t *game) {
+	for (uint32_t i = 0; i < options.threads; i++) {
+		work_queue_t *queue = &queues[(thread + i) % options.threads];
+		pthread_mutex_lock(&queue->lock);
+		int found = queue->front != queue->back;
+		if (found) {
+			*game = (i == 0) ? queue->games[queue->front++] : queue->games[--queue->back];
+		}
+		pthread_mutex_unlock(&queue->lock);
+		if (found) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void *worker(void *argument) {
+	uint32_t thread = (uint32_t)(uintptr_t)argument;
+	uint32_t game;
+	while (take_game(thread, &game)) {
+		play_game(game);
+	}
+	return 0;
+}
+
+static double elo_of(double score) {
+	if (score <= 0.0) {
+		return -INFINITY;
+	} else if (score >= 1.0) {
+		return INFINITY;
+	}
+	return 400.0 * log10(score / (1.0 - score));
+}
+
+static void print_move_stats(const char *name, const player_t *player,
+		const move_stats_t *stats) {
+	double mean = stats->moves ? stats->total_ms / stats->moves : 0.0;
+	double variance = stats->moves ? stats->total_squared_ms / stats->moves - mean * mean : 0.0;
+	printf("%s (%u ms", name, player->time_ms);
+	if (player->depth) {
+		printf(", depth %u", player->depth);
+	}
+	printf("): %llu moves, %.2f ms mean, %.2f ms sd, %.2f ms max, depth %.2f mean\n",
+			(unsigned long long)stats->moves, mean, sqrt(variance > 0.0 ? variance : 0.0),
+			stats->max_ms, stats->moves ? (double)stats->total_depth / stats->moves : 0.0);
+}
+
+static void print_results(double elapsed_ms) {
+	uint32_t games = results.wins + results.draws + results.losses;
+	double score = (results.wins + 0.5 * results.draws) / games;
+	// standard error of the mean score of a game
+	double variance = (results.wins * (1.0 - score) * (1.0 - score)
+			+ results.draws * (0.5 - score) * (0.5 - score)
+			+ results.losses * score * score) / games;
+	double error = sqrt(variance / games);
+
+	printf("%u games in %.1f s (%.1f games/s) on %u threads\n", games,
+			elapsed_ms / 1000.0, games * 1000.0 / elapsed_ms, options.threads);
+	printf("A: %u wins, %u draws, %u losses, score %.1f%%\n", results.wins,
+			results.draws, results.losses, 100.0 * score);
+	printf("Elo difference A - B: %+.1f (95%% interval %+.1f to %+.1f)\n",
+			elo_of(score), elo_of(score - 1.96 * error), elo_of(score + 1.96 * error));
+	print_move_stats("A", &options.players[0], &results.players[0]);
+	print_move_stats("B", &options.players[1], &results.players[1]);
+}
+
+static int parse_player(const char *text, player_t *player) {
+	char *end;
+	unsigned long time_ms = strtoul(text, &end, 10);
+	unsigned long depth = 0;
+	if (end == text || time_ms == 0 || time_ms > 60000) {
+		return 0;
+	}
+	if (*end == '/') {
+		text = end + 1;
+		depth = strtoul(text, &end, 10);
+		if (end == text || depth > SEARCH_MAX_DEPTH) {
+			return 0;
+		}
+	}
+	player->time_ms = (uint16_t)time_ms;
+	player->depth = (uint8_t)depth;
+	return *end == '\0';
+}
+
+static void usage(const char *program) {
+	fprintf(stderr, "usage: %s [-g games] [-j threads] [-a player] [-b player]\n"
+			"          [-r random_plies] [-s seed] [-o record_file]\n"
+			"a player is TIME_MS or TIME_MS/DEPTH\n", program);
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	int option;
+	while ((option = getopt(argc, argv, "g:j:a:b:r:s:o:")) != -1) {
+		switch (option) {
+			case 'g':	options.games = strtoul(optarg, 0, 10); break;
+			case 'j':	options.threads = strtoul(optarg, 0, 10); break;
+			case 'a':	if (!parse_player(optarg, &options.players[0])) usage(argv[0]); break;
+			case 'b':	if (!parse_player(optarg, &options.players[1])) usage(argv[0]); break;
+			case 'r':	options.random_plies = strtoul(optarg, 0, 10); break;
+			case 's':	options.seed = strtoul(optarg, 0, 10); break;
+			case 'o':	options.record_path = optarg; break;
+			default:	usage(argv[0]);
+		}
+	}
+	if (optind != argc || options.games == 0 || options.random_plies > 20) {
+		usage(argv[0]);
+	}
+	if (options.threads == 0) {
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		options.threads = cores > 0 ? cores : 1;
+	}
+	if (options.record_path) {
+		record_file = fopen(options.record_path, "wb");
+		if (!record_file) {
+			fprintf(stderr, "%s: %s\n", options.record_path, strerror(errno));
+			return 1;
+		}
+		fwrite("RVG1", 1, 4, record_file);
+	}
+
+	// deal the games out to the threads' queues
+	queues = calloc(options.threads, sizeof(work_queue_t));
+	for (uint32_t i = 0; i < options.threads; i++) {
+		pthread_mutex_init(&queues[i].lock, 0);
+		queues[i].games = malloc(sizeof(uint32_t) * (options.games / options.threads + 1));
+	}
+	for (uint32_t game = 0; game < options.games; game++) {
+		work_queue_t *queue = &queues[game % options.threads];
+		queue->games[queue->back++] = game;
+	}
+
+	init_timer0();
+	double start = now_ms();
+	pthread_t *threads = malloc(sizeof(pthread_t) * options.threads);
+	for (uint32_t i = 0; i < options.threads; i++) {
+		pthread_create(&threads[i], 0, worker, (void *)(uintptr_t)i);
+	}
+	for (uint32_t i = 0; i < options.threads; i++) {
+		pthread_join(threads[i], 0);
+	}
+	double elapsed = now_ms() - start;
+	if (isatty(STDERR_FILENO)) {
+		fprintf(stderr, "\n");
+	}
+
+	if (record_file) {
+		fclose(record_file);
+	}
+	print_results(elapsed);
+	return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * idle.c
+ *
+ * The main loop's sleeping. The check that there is nothing to do and
+ * going to sleep have to happen with interrupts off, or an event posted
+ * between the two would not wake the loop until the next interrupt. The
+ * AVR always runs the instruction after sei() before taking an
+ * interrupt, so "sei(); sleep_cpu();" turns them on and goes to sleep
+ * with no gap, and an event which is already on its way wakes the CPU
+ * straight away.
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "idle.h"
+#include "timer0.h"
+#include "timer1.h"
+
+volatile uint8_t idle_events;
+volatile uint16_t idle_event_cycles;
+volatile uint8_t idle_sequence;
+
+static idle_stats_t stats;
+// get_cycle_count() when the statistics were last brought up to date
+static uint32_t counted_up_to;
+
+void idle_init(void) {
+	idle_events = 0;
+	idle_stats_t no_stats = { 0 };
+	stats = no_stats;
+	counted_up_to = get_cycle_count();
+	set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+uint8_t idle_wait(uint32_t wake_time) {
+	uint8_t slept = 0;
+	while (1) {
+		cli();
+		if (idle_events) {
+			break;
+		}
+		if ((int32_t)(get_current_time() - wake_time) >= 0) {
+			idle_events = IDLE_TIMER;
+			break;
+		}
+		uint32_t sleep_start = get_cycle_count();
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		// the interrupt which woke the CPU has been dealt with by now,
+		// its time is counted as idle
+		stats.idle_cycles += get_cycle_count() - sleep_start;
+		slept = 1;
+	}
+
+	// take the events (interrupts are still off)
+	uint8_t events = idle_events;
+	idle_events = 0;
+	if (slept && (events & (IDLE_BUTTON | IDLE_SERIAL))) {
+		uint16_t latency = IDLE_CYCLES() - idle_event_cycles;
+		stats.wakes++;
+		stats.total_latency += latency;
+		if (latency > stats.max_latency) {
+			stats.max_latency = latency;
+		}
+	}
+	sei();
+
+	uint32_t now = get_cycle_count();
+	stats.total_cycles += now - counted_up_to;
+	counted_up_to = now;
+	return events;
+}
+
+void idle_get_stats(idle_stats_t *copy) {
+	*copy = stats;
+}
@@ -0,0 +1,94 @@
+/*
+ * idle.h
+ *
+ * Lets the main loop sleep when it has nothing to do. The interrupt
+ * handlers post an event when there is something new for it (a button
+ * pushed or let go, a character received) and idle_wait() puts the CPU
+ * in idle sleep mode until one comes, or until a given time. Idle mode
+ * keeps the timers and the serial port running, and any interrupt (timer
+ * 0's every millisecond, at least) wakes the CPU again.
+ *
+ * The time spent asleep is counted, so the statistics show how much of
+ * the time the CPU had nothing to do, along with how long it took the
+ * main loop to get going again after an event woke it.
+ */
+
+#ifndef IDLE_H_
+#define IDLE_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+
+#include "timer1.h"
+
+// the events which wake the main loop (bits of the value idle_wait()
+// returns)
+#define IDLE_BUTTON 0x01		// a button was pushed or let go
+#define IDLE_SERIAL 0x02		// a character was received
+#define IDLE_TIMER 0x04			// the time idle_wait() was given came
+
+// the longest the main loop sleeps if nothing wakes it (milliseconds)
+#ifndef IDLE_MAX_SLEEP_MS
+#define IDLE_MAX_SLEEP_MS 1000
+#endif
+
+typedef struct {
+	uint64_t total_cycles;		// since idle_init()
+	uint64_t idle_cycles;		// of those, asleep
+	uint32_t wakes;				// sleeps ended by a button or a character
+	uint32_t total_latency;		// cycles from the event to idle_wait()
+	uint16_t max_latency;		// returning, for those
+} idle_stats_t;
+
+// the events posted since idle_wait() last returned, and the low 16 bits
+// of the cycle count when the first of them was posted (see idle_post())
+extern volatile uint8_t idle_events;
+extern volatile uint16_t idle_event_cycles;
+
+// a count of the button events and characters queued, each is stamped
+// with it as it is queued so that the main loop can take them in the
+// order they came (see input_get_event()). Only interrupt handlers, which
+// don't interrupt each other, count on the board.
+extern volatile uint8_t idle_sequence;
+
+// returns the stamp for the next event queued
+static inline uint8_t idle_next_sequence(void) {
+	return idle_sequence++;
+}
+
+// returns 1 if the event stamped 'a' was queued before the one stamped
+// 'b' (no more than 127 events apart)
+#define IDLE_SEQUENCE_BEFORE(a, b) ((int8_t)((uint8_t)((a) - (b))) < 0)
+
+// the low 16 bits of the cycle count, read straight from timer 1 so
+// that interrupt handlers can use it (the host build has no timer
+// registers and asks for its cycle count)
+#ifdef TCNT1
+#define IDLE_CYCLES() TCNT1
+#else
+#define IDLE_CYCLES() ((uint16_t)get_cycle_count())
+#endif
+
+// post 'events' (IDLE_BUTTON or IDLE_SERIAL) for the main loop, from an
+// interrupt handler
+static inline void idle_post(uint8_t events) {
+	if (!idle_events) {
+		idle_event_cycles = IDLE_CYCLES();
+	}
+	idle_events |= events;
+}
+
+// choose idle sleep mode and start counting, call this once timer 1 has
+// been set up
+void idle_init(void);
+
+// sleep until an event is posted or get_current_time() reaches
+// 'wake_time', and return the events (IDLE_TIMER for the time coming).
+// Returns straight away if there are events waiting already or the time
+// has come.
+uint8_t idle_wait(uint32_t wake_time);
+
+// copy the sleep statistics into 'stats'
+void idle_get_stats(idle_stats_t *stats);
+
+#endif /* IDLE_H_ */
@@ -0,0 +1,68 @@
+/*
+ * input.c
+ *
+ * Merges the button events and the serial input, and looks keys up in
+ * the tables of bindings.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <avr/pgmspace.h>
+
+#include "input.h"
+#include "buttons.h"
+#include "idle.h"
+#include "serialio.h"
+#include "timer0.h"
+
+uint8_t input_get_event(input_event_t *event) {
+	while (1) {
+		// a character goes first if it came before the next push or
+		// release (repeats and long presses are made up now, so they
+		// come after anything waiting). The buttons are looked at first
+		// as on the host that takes in the characters typed as well.
+		uint8_t button_sequence;
+		uint8_t button_waiting = button_event_sequence(&button_sequence);
+		uint8_t serial_sequence;
+		if (serial_input_sequence(&serial_sequence) && !(button_waiting
+				&& IDLE_SEQUENCE_BEFORE(button_sequence, serial_sequence))) {
+			event->source = INPUT_SERIAL;
+			event->key = fgetc(stdin);
+			event->time = get_current_time();
+			return 1;
+		}
+
+		button_event_t button;
+		if (!button_get_event(&button)) {
+			return 0;
+		}
+		if (button.type == BUTTON_PRESS || button.type == BUTTON_REPEAT) {
+			event->source = INPUT_BUTTON;
+			event->key = button.button;
+			// a repeat's duration is how long the button had been held
+			event->time = button.press_time;
+			if (button.type == BUTTON_REPEAT) {
+				event->time += button.duration;
+			}
+			return 1;
+		}
+	}
+}
+
+uint8_t input_dispatch(const input_binding_t *bindings, const input_event_t *event) {
+	uint8_t key = event->key;
+	if (event->source == INPUT_SERIAL && key >= 'A' && key <= 'Z') {
+		key += 'a' - 'A';
+	}
+	input_binding_t binding;
+	for (;; bindings++) {
+		memcpy_P(&binding, bindings, sizeof(binding));
+		if (!binding.action) {
+			return 0;
+		}
+		if (binding.source == event->source && binding.key == key) {
+			binding.action(event);
+			return 1;
+		}
+	}
+}
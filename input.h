@@ -0,0 +1,51 @@
+/*
+ * input.h
+ *
+ * All the input the game takes, from the push buttons and the serial
+ * port, as one stream of events. Each event says where it came from, the
+ * key (the button's number, or the character) and when it happened.
+ *
+ * What each key does is looked up in a table of bindings kept in program
+ * memory, a table for each state the program can be in (see project.c),
+ * so a key which means nothing in a state simply has no binding there.
+ */
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <stdint.h>
+
+// where an event came from
+#define INPUT_BUTTON 0
+#define INPUT_SERIAL 1
+
+typedef struct {
+	uint8_t source;		// INPUT_BUTTON or INPUT_SERIAL
+	uint8_t key;		// the button (0 to 2) or the character
+	uint32_t time;		// get_current_time() when it happened
+} input_event_t;
+
+// a key and what it does. Letters are bound in lower case and match
+// either case.
+typedef struct {
+	uint8_t source;
+	uint8_t key;
+	void (*action)(const input_event_t *event);
+} input_binding_t;
+
+// ends a table of bindings
+#define INPUT_END { 0, 0, 0 }
+
+// take the next event and copy it into 'event', returns 1 if there was
+// one, 0 if not. Button pushes and characters come in the order they
+// were queued, and a repeat (with the time of the repeat) when it is due.
+// The time of a character is when it was taken. Button releases and long
+// presses are skipped.
+uint8_t input_get_event(input_event_t *event);
+
+// carry out the action 'bindings' (a table in program memory, ending
+// with INPUT_END) has for 'event'. Returns 1 if there was one, 0 if the
+// key has no binding.
+uint8_t input_dispatch(const input_binding_t *bindings, const input_event_t *event);
+
+#endif /* INPUT_H_ */
@@ -19,6 +19,16 @@
 #include "terminalio.h"
 #include "timer0.h"
 #include "scoring.h"
+#include "search.h"
+#include "book.h"
+#include "timer1.h"
+#include "bench.h"
+#include "render.h"
+#include "baud.h"
+#include "remote.h"
+#include "scheduler.h"
+#include "idle.h"
+#include "input.h"
 
 #define F_CPU 16000000L
 #include <util/delay.h>
@@ -26,6 +36,7 @@
 // Function prototypes - these are defined below (after main()) in the order
 // given here
 void initialise_hardware(void);
+void show_start_screen(void);
 void start_screen(void);
 void new_game(void);
 void play_game(void);
@@ -34,6 +45,124 @@ void handle_game_over(void);
 // check if the game is paused
 uint8_t pause = 0;
 
+// the player the computer plays as, or 0 if both players are people
+#define COMPUTER_PLAYER PLAYER_2
+uint8_t computer_player = 0;
+
+// how long the computer may think about each move (milliseconds)
+#define COMPUTER_TIME_BUDGET 2000
+
+// where the statistics of the computer's last search are shown
+#define SEARCH_STATS_X 2
+#define SEARCH_STATS_Y 23
+
+// where the display statistics are shown when 'i' is pressed: to the
+// left of the board, on the rows beside it, in lines which stop short of
+// it. They take eight lines, then three for each scheduler task (as
+// many as there is room for) and two more if ISR_PROFILE is set.
+#define DISPLAY_STATS_X 2
+#define DISPLAY_STATS_Y TERMINAL_BOARD_Y
+#define DISPLAY_STATS_LAST_Y (TERMINAL_BOARD_Y + BOARD_LINES - 1)
+#define DISPLAY_STATS_WIDTH (TERMINAL_BOARD_X - DISPLAY_STATS_X - 1)
+
+// the rows the display statistics take up, cleared when the game ends
+static uint8_t display_stats_rows;
+
+// status lines (the computer's statistics) which were not shown as the
+// serial port was busy
+uint16_t status_lines_dropped = 0;
+
+// the cursor blinks while a game is being played
+#define CURSOR_FLASH_MS 500
+static scheduler_task_t cursor_task;
+static const char cursor_task_name[] PROGMEM = "cursor";
+
+void computer_turn(void);
+void show_display_stats(void);
+void hide_display_stats(void);
+uint8_t input_wanted(void);
+uint8_t computer_to_move(void);
+void wait_for_work(uint8_t busy, uint8_t drawing);
+
+// What the keys and buttons do (see input.h). There is a table of
+// bindings for each mode the program can be in, and handle_input() looks
+// up each key in the one for the mode it is in.
+#define MODE_START 0
+#define MODE_PLAYING 1
+#define MODE_PAUSED 2
+#define MODE_GAME_OVER 3
+
+// the actions, defined after the game's functions
+void choose_two_players(const input_event_t *event);
+void choose_computer(const input_event_t *event);
+void benchmark_action(const input_event_t *event);
+void serial_benchmark_action(const input_event_t *event);
+void baud_action(const input_event_t *event);
+void remote_action(const input_event_t *event);
+void cursor_up(const input_event_t *event);
+void cursor_down(const input_event_t *event);
+void cursor_left(const input_event_t *event);
+void cursor_right(const input_event_t *event);
+void place_action(const input_event_t *event);
+void stats_action(const input_event_t *event);
+void pause_action(const input_event_t *event);
+void game_over_done(const input_event_t *event);
+
+static const input_binding_t start_bindings[] PROGMEM = {
+	{ INPUT_SERIAL, 's', choose_two_players },
+	{ INPUT_SERIAL, 'c', choose_computer },
+	{ INPUT_SERIAL, 'b', benchmark_action },
+	{ INPUT_SERIAL, 't', serial_benchmark_action },
+	// a request for a faster baud rate from the computer at the other
+	// end (see baud.h), and another program taking control (remote.h)
+	{ INPUT_SERIAL, BAUD_SYN, baud_action },
+	{ INPUT_SERIAL, REMOTE_ENQ, remote_action },
+	{ INPUT_BUTTON, BUTTON0_PUSHED, choose_two_players },
+	{ INPUT_BUTTON, BUTTON1_PUSHED, choose_two_players },
+	{ INPUT_BUTTON, BUTTON2_PUSHED, choose_two_players },
+	INPUT_END
+};
+
+static const input_binding_t playing_bindings[] PROGMEM = {
+	{ INPUT_SERIAL, 'w', cursor_up },
+	{ INPUT_SERIAL, 's', cursor_down },
+	{ INPUT_SERIAL, 'a', cursor_left },
+	{ INPUT_SERIAL, 'd', cursor_right },
+	{ INPUT_SERIAL, ' ', place_action },
+	{ INPUT_SERIAL, 'i', stats_action },
+	{ INPUT_SERIAL, 'p', pause_action },
+	{ INPUT_BUTTON, BUTTON0_PUSHED, place_action },
+	{ INPUT_BUTTON, BUTTON1_PUSHED, cursor_up },
+	{ INPUT_BUTTON, BUTTON2_PUSHED, cursor_left },
+	INPUT_END
+};
+
+static const input_binding_t paused_bindings[] PROGMEM = {
+	{ INPUT_SERIAL, 'i', stats_action },
+	{ INPUT_SERIAL, 'p', pause_action },
+	INPUT_END
+};
+
+static const input_binding_t game_over_bindings[] PROGMEM = {
+	{ INPUT_BUTTON, BUTTON0_PUSHED, game_over_done },
+	{ INPUT_BUTTON, BUTTON1_PUSHED, game_over_done },
+	{ INPUT_BUTTON, BUTTON2_PUSHED, game_over_done },
+	INPUT_END
+};
+
+// indexed by mode
+static const input_binding_t *const mode_bindings[] PROGMEM = {
+	start_bindings,
+	playing_bindings,
+	paused_bindings,
+	game_over_bindings
+};
+
+// set by the actions which end the start screen or the game over screen
+uint8_t screen_done;
+
+void handle_input(uint8_t mode, const input_event_t *event);
+
 
 /////////////////////////////// main //////////////////////////////////
 int main(void) {
@@ -56,45 +185,52 @@ int main(void) {
 void initialise_hardware(void) {
 	init_button_interrupts();
 	// Setup serial port for 19200 baud communication with no echo
-	// of incoming characters
+	// of incoming characters (the computer at the other end can ask
+	// for a faster rate from the start screen, see baud.h)
 	init_serial_stdio(19200,0);
 	
 	init_timer0();
+	init_timer1();
+	scheduler_init();
+	idle_init();
 	
 	// Turn on global interrupts
 	sei();
 }
 
-void start_screen(void) {
+// draw the start screen
+void show_start_screen(void) {
 	// Clear terminal screen and output a message
 	clear_terminal();
 	move_terminal_cursor(10,10);
-	printf_P(PSTR("Reversi"));
+	term_print_P(PSTR("Reversi"));
 	move_terminal_cursor(10,12);
-	printf_P(PSTR("CSSE2010/7201 project by <Donghao Yang 45930032>"));
+	term_print_P(PSTR("CSSE2010/7201 project by <Donghao Yang 45930032>"));
+	move_terminal_cursor(10,14);
+	term_print_P(PSTR("Press 's' for two players, 'c' to play against the computer"));
+	move_terminal_cursor(10,16);
+	term_print_P(PSTR("('b' runs the benchmarks, 't' the serial one)"));
 	
-	// Output the static start screen and wait for a push button 
-	// to be pushed or a serial input of 's'
+	// Output the static start screen
 	start_display();
+}
+
+void start_screen(void) {
+	// show the start screen and wait for a push button to be pushed or
+	// a serial input of 's' (or 'c')
+	show_start_screen();
 	
-	// Wait until a button is pressed, or 's' is pressed on the terminal
-	while(1) {
-		// First check for if a 's' is pressed
-		// There are two steps to this
-		// 1) collect any serial input (if available)
-		// 2) check if the input is equal to the character 's'
-		char serial_input = -1;
-		if (serial_input_available()) {
-			serial_input = fgetc(stdin);
-		}
-		// If the serial input is 's', then exit the start screen
-		if (serial_input == 's' || serial_input == 'S') {
-			break;
+	screen_done = 0;
+	while(!screen_done) {
+		// take the keys and buttons which have come in until one of
+		// them starts a game
+		input_event_t event;
+		while (!screen_done && input_get_event(&event)) {
+			handle_input(MODE_START, &event);
 		}
-		// Next check for any button presses
-		int8_t btn = button_pushed();
-		if (btn != NO_BUTTON_PUSHED) {
-			break;
+		// and sleep until there is another key or button
+		if (!screen_done) {
+			wait_for_work(serial_input_available(), 0);
 		}
 	}
 }
@@ -102,6 +238,7 @@ void start_screen(void) {
 void new_game(void) {
 	// Clear the serial terminal
 	clear_terminal();
+	display_stats_rows = 0;
 	
 	// Initialise the game and display
 	initialise_board();
@@ -113,99 +250,300 @@ void new_game(void) {
 	
 	// Initialise scores
 	init_score();
+	
+	// and have the computer player start afresh
+	search_new_game();
 }
 
 void play_game(void) {
 	
-	uint32_t last_flash_time, current_time;
-	uint8_t btn; //the button pushed
-	
-	last_flash_time = get_current_time();
+	// flash the cursor every CURSOR_FLASH_MS (0.5 second)
+	scheduler_start(&cursor_task, cursor_task_name, flash_cursor,
+			CURSOR_FLASH_MS, CURSOR_FLASH_MS);
 	
 	// We play the game until it's over
 	while(!is_game_over() && !no_available_move_game_over()) {
-		// First check for buttons pressed
-		
-		// We need to check if any button has been pushed, this will be
-		// NO_BUTTON_PUSHED if no button has been pushed
-		btn = button_pushed();
-		
-		if (btn == BUTTON2_PUSHED && pause == 0) {
-			// If button 2 is pushed, move left,
-			// i.e decrease x by 1 and leave y the same
-			move_display_cursor(-1, 0);
-		} else if (btn == BUTTON1_PUSHED && pause == 0) {
-			// If button 1 is pushed, move upwards,
-			// i.e leave x the same and increase y by 1
-			move_display_cursor(0, 1);
+		// take all the buttons and keys that have come in, so that keys
+		// sent faster than the loop goes round (pasted, or from a script)
+		// don't pile up and get lost
+		input_event_t event;
+		while (input_wanted() && input_get_event(&event)) {
+			handle_input(pause ? MODE_PAUSED : MODE_PLAYING, &event);
 		}
 		
-		// check for if "A, a, S, s, D, d, W, w" pressed
-		// There are two steps to this
-		// 1) collect any serial input (if available)
-		// 2) check if the input is equal to the character
-		// 'A', 'a', 'S', 's', 'D', 'd', 'W', 'w'
-		char serial_input_game_play = -1;
-		if (serial_input_available()) {
-			serial_input_game_play = fgetc(stdin);
-		}
-		// Check serial input and move the cursor
-		if (serial_input_game_play == 's' || serial_input_game_play == 'S') {
-			if (pause == 0) {
-				move_display_cursor(0, -1);
-			}
-		} else if (serial_input_game_play == 'w' || serial_input_game_play == 'W') {
-			if (pause == 0) {
-				move_display_cursor(0, 1);
-			}
-		} else if (serial_input_game_play == 'a' || serial_input_game_play == 'A') {
-			if (pause == 0) {
-				move_display_cursor(-1, 0);
-			}
-		} else if (serial_input_game_play == 'd' || serial_input_game_play == 'D') {
-			if (pause == 0) {
-				move_display_cursor(1, 0);
-			}
-		} else if (serial_input_game_play == 'p' || serial_input_game_play == 'P') {
-			pause_game();
-			if (pause == 0) {
-				pause = 1;
-			} else {
-				pause = 0;
-			}
+		// let the computer move when it is its turn
+		if (computer_to_move()) {
+			computer_turn();
 		}
 		
-		// a piece can be placed at the current location of the cursor when button B0 or
-		//space bar are pressed
-		// check if button 0 is pressed
-		if (btn == BUTTON0_PUSHED && pause == 0) {
-			piece_placement();
-		}
-		// check if space bar is pressed
-		if (serial_input_game_play == ' ' && pause == 0) {
-			piece_placement();
-		}
+		// run whatever timers are due (flashing the cursor)
+		scheduler_run();
 		
-		current_time = get_current_time();
-		if(current_time >= last_flash_time + 500) {
-			// 500ms (0.5 second) has passed since the last time we
-			// flashed the cursor, so flash the cursor
-			flash_cursor();
-			
-			// Update the most recent time the cursor was flashed
-			last_flash_time = current_time;
-		}
+		// draw whatever has changed on the board and the scores, once a
+		// frame time has passed
+		render_frame();
+		
+		// and sleep until there is something else to do
+		wait_for_work((serial_input_available() && input_wanted())
+				|| computer_to_move(), 1);
 	}
 	// We get here if the game is over.
+	scheduler_cancel(&cursor_task);
+	render_flush();
+}
+
+// check whether more keys and buttons can be taken now: not once the
+// game is over, and not while the computer has a move to make (the ones
+// after it are left until it has made it), unless the game is paused
+uint8_t input_wanted(void) {
+	if (is_game_over() || no_available_move_game_over()) {
+		return 0;
+	}
+	return pause || get_current_player() != computer_player;
+}
+
+// check whether it is the computer's turn to move (and it can)
+uint8_t computer_to_move(void) {
+	return get_current_player() == computer_player && pause == 0
+			&& !is_game_over() && !no_available_move_game_over();
+}
+
+// sleep until a button is pushed, a key comes in or a task is due (or a
+// frame, if the caller is 'drawing' them with render_frame()), unless the
+// caller is 'busy' (has something to do already)
+void wait_for_work(uint8_t busy, uint8_t drawing) {
+	uint32_t wake_time = get_current_time();
+	if (!busy) {
+		wake_time += IDLE_MAX_SLEEP_MS;
+		button_wake_time(&wake_time);
+		scheduler_wake_time(&wake_time);
+		// only the game draws frames (the board is marked to be drawn
+		// before the game starts, and while the renderer is turned off)
+		if (drawing) {
+			render_wake_time(&wake_time);
+		}
+	}
+	idle_wait(wake_time);
+}
+
+void computer_turn(void) {
+	// play straight from the opening book while the game is still in it
+	uint8_t book_move = get_book_move();
+	if (book_move != NO_BOOK_MOVE) {
+		place_piece(book_move);
+		const book_stats_t *book = book_get_stats();
+		if (!term_status_printf_P(SEARCH_STATS_X, SEARCH_STATS_Y,
+				PSTR("Computer: book move, %lu cycles to find (book is %u bytes)"),
+				(unsigned long)book->last_cycles, (unsigned)book->size)) {
+			status_lines_dropped++;
+		}
+		return;
+	}
+	
+	// show the last move before the computer starts thinking
+	render_flush();
+	
+	// search a copy of the game so the game itself is never disturbed
+	position_t position = *get_game_position();
+	search_result_t result = search_best_move(&position, COMPUTER_TIME_BUDGET);
+	if (result.best_move != PASS_MOVE) {
+		place_piece(result.best_move);
+	}
+	
+	// report how the search went, if the serial port has room for it
+	uint8_t shown;
+	if (result.solved == SEARCH_EXACT) {
+		shown = term_status_printf_P(SEARCH_STATS_X, SEARCH_STATS_Y,
+				PSTR("Computer: solved, final margin %+d, %6lu nodes, %5lu ms"),
+				(int)result.score, (unsigned long)result.nodes,
+				(unsigned long)result.time_ms);
+	} else if (result.solved == SEARCH_WLD) {
+		shown = term_status_printf_P(SEARCH_STATS_X, SEARCH_STATS_Y,
+				PSTR("Computer: solved for win/loss/draw (%+d), %6lu nodes, %5lu ms"),
+				(int)result.score, (unsigned long)result.nodes,
+				(unsigned long)result.time_ms);
+	} else {
+		shown = term_status_printf_P(SEARCH_STATS_X, SEARCH_STATS_Y,
+				PSTR("Computer: depth %2u, %6lu nodes, %5lu ms, TT %lu/%lu hits %lu cuts"),
+				(unsigned)result.depth, (unsigned long)result.nodes,
+				(unsigned long)result.time_ms, (unsigned long)result.tt_hits,
+				(unsigned long)result.tt_probes, (unsigned long)result.tt_cutoffs);
+	}
+	if (!shown) {
+		status_lines_dropped++;
+	}
+}
+
+// show a line of the display statistics on row *y, and move *y on to
+// the next row
+#define STATS_LINE(y, ...) term_field_printf_P(DISPLAY_STATS_X, (y)++, \
+		DISPLAY_STATS_WIDTH, __VA_ARGS__)
+
+void show_display_stats(void) {
+	const display_stats_t *stats = get_display_stats();
+	const render_stats_t *frames = get_render_stats();
+	uint8_t y = DISPLAY_STATS_Y;
+	serial_rx_stats_t rx;
+	serial_get_rx_stats(&rx);
+	STATS_LINE(y, PSTR("Cells: %lu sent, %lu skipped"),
+			(unsigned long)stats->cells_written, (unsigned long)stats->cells_skipped);
+	STATS_LINE(y, PSTR("Bytes: %lu sent, %lu saved by skips"),
+			(unsigned long)serial_bytes_sent(), (unsigned long)stats->bytes_saved);
+	STATS_LINE(y, PSTR("Input: %u overruns, %u dropped"),
+			(unsigned)rx.overruns, (unsigned)rx.dropped);
+	button_stats_t buttons;
+	button_get_stats(&buttons);
+	STATS_LINE(y, PSTR("Frames: %lu drawn, %lu dropped"),
+			(unsigned long)frames->frames, (unsigned long)frames->frames_skipped);
+	STATS_LINE(y, PSTR("  max %u bytes, %lu with cursor late"),
+			(unsigned)frames->max_frame_bytes, (unsigned long)frames->cursor_deferred);
+	STATS_LINE(y, PSTR("Dropped: %u status lines, %u buttons"),
+			(unsigned)status_lines_dropped, (unsigned)buttons.dropped);
+	// how much of the time the CPU has been asleep, and how long it has
+	// taken to get going again when woken
+	idle_stats_t idle;
+	idle_get_stats(&idle);
+	uint16_t idle_permille = idle.total_cycles ? idle.idle_cycles * 1000 / idle.total_cycles : 0;
+	STATS_LINE(y, PSTR("Idle: %u.%u%% of the time, woken %lu times"),
+			idle_permille / 10, idle_permille % 10, (unsigned long)idle.wakes);
+	STATS_LINE(y, PSTR("  %lu cycles to wake on average, %u max"),
+			(unsigned long)(idle.wakes ? idle.total_latency / idle.wakes : 0),
+			(unsigned)idle.max_latency);
+	// how the tasks run by the scheduler have been getting on
+	for (const scheduler_task_t *task = scheduler_first_task();
+			task && y + 2 <= DISPLAY_STATS_LAST_Y; task = scheduler_next_task(task)) {
+		const scheduler_stats_t *run = &task->stats;
+		uint16_t runs = run->runs ? run->runs : 1;
+		char name[DISPLAY_STATS_WIDTH + 1];
+		strncpy_P(name, task->name, sizeof(name) - 1);
+		name[sizeof(name) - 1] = 0;
+		STATS_LINE(y, PSTR("Task %s: %u runs"), name, (unsigned)run->runs);
+		STATS_LINE(y, PSTR("  %lu cycles on average, %lu max"),
+				(unsigned long)(run->total_cycles / runs), (unsigned long)run->max_cycles);
+		STATS_LINE(y, PSTR("  %lu ms late on average, %u max"),
+				(unsigned long)(run->total_late_ms / runs), (unsigned)run->max_late_ms);
+	}
+#if ISR_PROFILE
+	// the cycles spent in timer 0's interrupt handler each millisecond,
+	// and in the button sampling it does every BUTTON_SAMPLE_MS
+	isr_profile_t timer, sampling;
+	get_timer0_profile(&timer, &sampling);
+	if (y + 1 <= DISPLAY_STATS_LAST_Y) {
+		STATS_LINE(y, PSTR("Timer 0: %lu cycles on average, %u max"),
+				(unsigned long)(timer.calls ? timer.total_cycles / timer.calls : 0),
+				(unsigned)timer.max_cycles);
+		STATS_LINE(y, PSTR("Sampling: %lu cycles on average, %u max"),
+				(unsigned long)(sampling.calls ? sampling.total_cycles / sampling.calls : 0),
+				(unsigned)sampling.max_cycles);
+	}
+#endif
+	display_stats_rows = y - DISPLAY_STATS_Y;
+}
+
+void hide_display_stats(void) {
+	uint8_t y = DISPLAY_STATS_Y;
+	while (display_stats_rows) {
+		STATS_LINE(y, PSTR(""));
+		display_stats_rows--;
+	}
 }
 
 void handle_game_over() {
+	// the statistics would be mixed up with the message
+	hide_display_stats();
 	move_terminal_cursor(10,14);
-	printf_P(PSTR("GAME OVER"));
+	term_print_P(PSTR("GAME OVER"));
 	move_terminal_cursor(10,15);
-	printf_P(PSTR("Press a button to start again"));
+	term_print_P(PSTR("Press a button to start again"));
 	
-	while(button_pushed() == NO_BUTTON_PUSHED) {
-		; // wait
+	screen_done = 0;
+	while(!screen_done) {
+		input_event_t event;
+		while (!screen_done && input_get_event(&event)) {
+			handle_input(MODE_GAME_OVER, &event);
+		}
+		// wait, asleep
+		if (!screen_done) {
+			wait_for_work(0, 0);
+		}
+	}
+}
+
+// look up what 'event' does in 'mode' and do it
+void handle_input(uint8_t mode, const input_event_t *event) {
+	input_dispatch(pgm_read_ptr(&mode_bindings[mode]), event);
+}
+
+void choose_two_players(const input_event_t *event) {
+	computer_player = 0;
+	screen_done = 1;
+}
+
+void choose_computer(const input_event_t *event) {
+	computer_player = COMPUTER_PLAYER;
+	screen_done = 1;
+}
+
+// run the benchmarks and wait again afterwards
+void benchmark_action(const input_event_t *event) {
+	run_render_benchmark();
+	run_perft_benchmark();
+	run_endgame_benchmark();
+	run_tt_benchmark();
+	run_serial_benchmark();
+	printf_P(PSTR("Press 's' for two players, 'c' to play against the computer\n"));
+}
+
+// just time the serial port
+void serial_benchmark_action(const input_event_t *event) {
+	run_serial_benchmark();
+}
+
+void baud_action(const input_event_t *event) {
+	negotiate_baud();
+}
+
+// let the other program have control, and then start again
+void remote_action(const input_event_t *event) {
+	run_remote();
+	show_start_screen();
+}
+
+void cursor_up(const input_event_t *event) {
+	move_display_cursor(0, 1);
+}
+
+void cursor_down(const input_event_t *event) {
+	move_display_cursor(0, -1);
+}
+
+void cursor_left(const input_event_t *event) {
+	move_display_cursor(-1, 0);
+}
+
+void cursor_right(const input_event_t *event) {
+	move_display_cursor(1, 0);
+}
+
+// a piece can be placed at the current location of the cursor when B0
+// or the space bar is pressed
+void place_action(const input_event_t *event) {
+	piece_placement();
+}
+
+void stats_action(const input_event_t *event) {
+	show_display_stats();
+}
+
+void pause_action(const input_event_t *event) {
+	pause_game();
+	if (pause == 0) {
+		pause = 1;
+	} else {
+		pause = 0;
 	}
 }
+
+void game_over_done(const input_event_t *event) {
+	screen_done = 1;
+}
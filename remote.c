@@ -0,0 +1,255 @@
+/*
+ * remote.c
+ *
+ * Remote control over the serial port, see remote.h for the messages.
+ * Frames are read a byte at a time as they arrive and answered straight
+ * away, so the board never has more than one reply on its way.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include "remote.h"
+#include "book.h"
+#include "buttons.h"
+#include "game.h"
+#include "render.h"
+#include "scoring.h"
+#include "search.h"
+#include "serialio.h"
+#include "timer0.h"
+
+// the payload length each command takes, indexed by its type (REMOTE_HELLO
+// is only ever sent by the board)
+#define NO_COMMAND 0xFF
+static const uint8_t command_lengths[] PROGMEM = {
+	NO_COMMAND,	// REMOTE_HELLO
+	0,			// REMOTE_NEW_GAME
+	1,			// REMOTE_PLACE
+	0,			// REMOTE_GET_MOVES
+	0,			// REMOTE_GET_POSITION
+	0,			// REMOTE_GET_STATS
+	2,			// REMOTE_COMPUTER_MOVE
+	0			// REMOTE_EXIT
+};
+
+#define NUM_COMMANDS (sizeof(command_lengths) / sizeof(command_lengths[0]))
+
+// the bytes around the payload: start, length, type and the CRC
+#define FRAME_OVERHEAD 5
+
+// counts of the frames received since remote mode was entered
+static struct {
+	uint16_t frames;
+	uint16_t crc_errors;
+	uint16_t bad_frames;
+} stats;
+
+// store the low 'bytes' bytes of 'value' at 'out', lowest first, and
+// return where the next value goes
+static uint8_t *put_le(uint8_t *out, uint64_t value, uint8_t bytes) {
+	for (uint8_t i = 0; i < bytes; i++) {
+		*out++ = (uint8_t)value;
+		value >>= 8;
+	}
+	return out;
+}
+
+static void send_frame(uint8_t type, const uint8_t *payload, uint8_t length) {
+	uint8_t frame[REMOTE_MAX_PAYLOAD + FRAME_OVERHEAD];
+	frame[0] = REMOTE_SOF;
+	frame[1] = length;
+	frame[2] = type;
+	uint16_t crc = _crc_xmodem_update(_crc_xmodem_update(0, length), type);
+	for (uint8_t i = 0; i < length; i++) {
+		frame[3 + i] = payload[i];
+		crc = _crc_xmodem_update(crc, payload[i]);
+	}
+	frame[3 + length] = crc >> 8;
+	frame[4 + length] = (uint8_t)crc;
+	serial_write(frame, length + FRAME_OVERHEAD);
+}
+
+static void send_error(uint8_t type, uint8_t code) {
+	uint8_t payload[2] = { type, code };
+	send_frame(REMOTE_ERROR, payload, sizeof(payload));
+}
+
+static void send_position(uint8_t type) {
+	const position_t *pos = get_game_position();
+	uint8_t payload[18];
+	uint8_t *out = put_le(payload, pos->pieces[0], 8);
+	out = put_le(out, pos->pieces[1], 8);
+	*out++ = pos->side;
+	*out = position_game_over(pos);
+	send_frame(type | REMOTE_REPLY, payload, sizeof(payload));
+}
+
+static void send_stats(void) {
+	serial_rx_stats_t rx;
+	serial_get_rx_stats(&rx);
+	uint8_t payload[10];
+	uint8_t *out = put_le(payload, stats.frames, 2);
+	out = put_le(out, stats.crc_errors, 2);
+	out = put_le(out, stats.bad_frames, 2);
+	out = put_le(out, rx.overruns, 2);
+	put_le(out, rx.dropped, 2);
+	send_frame(REMOTE_GET_STATS | REMOTE_REPLY, payload, sizeof(payload));
+}
+
+// let the computer make a move for the player to move, as in a game
+// against it (from the opening book if it can)
+static void computer_move(uint16_t time_budget_ms) {
+	search_result_t result = { 0 };
+	uint8_t book_move = get_book_move();
+	if (book_move != NO_BOOK_MOVE) {
+		result.best_move = book_move;
+	} else {
+		// search a copy of the game so the game itself is never disturbed
+		position_t position = *get_game_position();
+		result = search_best_move(&position, time_budget_ms);
+	}
+	if (result.best_move != PASS_MOVE) {
+		place_piece(result.best_move);
+	}
+
+	uint8_t payload[13];
+	uint8_t *out = payload;
+	*out++ = result.best_move;
+	*out++ = result.depth;
+	*out++ = result.solved;
+	out = put_le(out, (uint16_t)result.score, 2);
+	out = put_le(out, result.nodes, 4);
+	put_le(out, result.time_ms, 4);
+	send_frame(REMOTE_COMPUTER_MOVE | REMOTE_REPLY, payload, sizeof(payload));
+}
+
+// carry out a command and send the reply, returns 0 if remote mode is to
+// be left
+static uint8_t do_command(uint8_t type, const uint8_t *payload, uint8_t length) {
+	if (type >= NUM_COMMANDS || pgm_read_byte(&command_lengths[type]) == NO_COMMAND) {
+		send_error(type, REMOTE_ERROR_COMMAND);
+		return 1;
+	}
+	if (length != pgm_read_byte(&command_lengths[type])) {
+		send_error(type, REMOTE_ERROR_LENGTH);
+		return 1;
+	}
+
+	switch (type) {
+	case REMOTE_NEW_GAME:
+		initialise_board();
+		init_score();
+		search_new_game();
+		send_position(type);
+		break;
+	case REMOTE_PLACE:
+		if (position_game_over(get_game_position())) {
+			send_error(type, REMOTE_ERROR_GAME_OVER);
+		} else if (payload[0] >= PASS_MOVE
+				|| !check_valid_place(SQUARE_X(payload[0]), SQUARE_Y(payload[0]))) {
+			send_error(type, REMOTE_ERROR_ILLEGAL);
+		} else {
+			place_piece(payload[0]);
+			send_position(type);
+		}
+		break;
+	case REMOTE_GET_MOVES: {
+		uint8_t moves[8];
+		put_le(moves, legal_moves(get_game_position()), 8);
+		send_frame(type | REMOTE_REPLY, moves, sizeof(moves));
+		break;
+	}
+	case REMOTE_GET_POSITION:
+		send_position(type);
+		break;
+	case REMOTE_GET_STATS:
+		send_stats();
+		break;
+	case REMOTE_COMPUTER_MOVE:
+		if (position_game_over(get_game_position())) {
+			send_error(type, REMOTE_ERROR_GAME_OVER);
+		} else {
+			computer_move(payload[0] | (payload[1] << 8));
+		}
+		break;
+	case REMOTE_EXIT:
+		send_frame(type | REMOTE_REPLY, payload, 0);
+		return 0;
+	}
+	return 1;
+}
+
+// wait for the next byte of a frame, returns -1 if it doesn't come within
+// REMOTE_BYTE_MS
+static int16_t next_byte(void) {
+	uint32_t start_time = get_current_time();
+	while (!serial_input_available()) {
+		if (get_current_time() - start_time >= REMOTE_BYTE_MS) {
+			return -1;
+		}
+	}
+	return (uint8_t)fgetc(stdin);
+}
+
+// read the rest of a frame after its REMOTE_SOF and act on it, returns 0
+// if remote mode is to be left
+static uint8_t read_frame(void) {
+	uint8_t payload[REMOTE_MAX_PAYLOAD];
+	int16_t length = next_byte();
+	int16_t type = next_byte();
+	if (length < 0 || type < 0 || length > REMOTE_MAX_PAYLOAD) {
+		stats.bad_frames++;
+		return 1;
+	}
+	uint16_t crc = _crc_xmodem_update(_crc_xmodem_update(0, length), type);
+	for (uint8_t i = 0; i < length; i++) {
+		int16_t byte = next_byte();
+		if (byte < 0) {
+			stats.bad_frames++;
+			return 1;
+		}
+		payload[i] = byte;
+		crc = _crc_xmodem_update(crc, byte);
+	}
+	int16_t crc_high = next_byte();
+	int16_t crc_low = next_byte();
+	if (crc_high < 0 || crc_low < 0) {
+		stats.bad_frames++;
+		return 1;
+	}
+	if (crc != (uint16_t)((crc_high << 8) | crc_low)) {
+		stats.crc_errors++;
+		send_error(type, REMOTE_ERROR_CRC);
+		return 1;
+	}
+	stats.frames++;
+	return do_command(type, payload, length);
+}
+
+void run_remote(void) {
+	// nothing but frames may be sent from now on
+	render_set_enabled(0);
+	serial_set_binary(1);
+	stats.frames = 0;
+	stats.crc_errors = 0;
+	stats.bad_frames = 0;
+
+	uint8_t version = REMOTE_VERSION;
+	send_frame(REMOTE_HELLO | REMOTE_REPLY, &version, 1);
+
+	while (button_pushed() == NO_BUTTON_PUSHED) {
+		// anything between frames is ignored
+		if (!serial_input_available() || (uint8_t)fgetc(stdin) != REMOTE_SOF) {
+			continue;
+		}
+		if (!read_frame()) {
+			break;
+		}
+	}
+
+	serial_set_binary(0);
+	render_set_enabled(1);
+}
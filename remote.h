@@ -0,0 +1,93 @@
+/*
+ * remote.h
+ *
+ * Remote control of the game over the serial port by another program (a
+ * bot to play against, or automated tests) using short binary messages
+ * instead of keys and escape sequences. tools/remote.py is a client.
+ *
+ * Remote mode is entered by sending REMOTE_ENQ on its own at the start
+ * screen. The board stops drawing on the terminal, takes input as binary
+ * (see serial_set_binary()) and sends a REMOTE_HELLO reply, after
+ * which it answers every frame it is sent with one frame. REMOTE_EXIT, or
+ * any push button, goes back to the start screen.
+ *
+ * A frame is
+ *
+ *   REMOTE_SOF, length, type, payload (length bytes), CRC (2 bytes)
+ *
+ * where the CRC is CRC-16/XMODEM (polynomial 0x1021, starting from 0) of
+ * the length, type and payload bytes, high byte first. Numbers in the
+ * payload are little-endian. The bytes of a frame must follow each other
+ * within REMOTE_BYTE_MS, otherwise what has arrived is thrown away.
+ *
+ * Commands, and the payload of the frames sent back. A reply has the
+ * type of the command with REMOTE_REPLY set, or is REMOTE_ERROR:
+ *
+ *   REMOTE_NEW_GAME                 replies with the position
+ *   REMOTE_PLACE       square       plays square (x + 8 * y) for the player
+ *                                   to move and replies with the position
+ *   REMOTE_GET_MOVES                legal moves of the player to move (8)
+ *   REMOTE_GET_POSITION             the position: player 1's and player 2's
+ *                                   pieces (8 each), the player to move (0
+ *                                   or 1), and 1 if the game is over
+ *   REMOTE_GET_STATS                counts since remote mode was entered
+ *                                   (2 bytes each): good frames, frames
+ *                                   with a bad CRC, frames thrown away as
+ *                                   incomplete or too long, then the
+ *                                   serial port's overruns and dropped
+ *                                   bytes (since it started)
+ *   REMOTE_COMPUTER_MOVE  time (2)  the computer searches for up to time
+ *                                   milliseconds and plays its move. The
+ *                                   reply is the square played (or
+ *                                   PASS_MOVE), the depth, solved and
+ *                                   score (2) from search_result_t, the
+ *                                   nodes (4) and the time taken (4)
+ *   REMOTE_EXIT                     leaves remote mode (empty reply)
+ *
+ *   REMOTE_ERROR       type, code   the command was not carried out
+ */
+
+#ifndef REMOTE_H_
+#define REMOTE_H_
+
+#include <stdint.h>
+
+// sent to the board to enter remote mode
+#define REMOTE_ENQ 0x05
+
+// the first byte of every frame
+#define REMOTE_SOF 0xA5
+
+// the longest payload
+#define REMOTE_MAX_PAYLOAD 24
+
+// the longest gap allowed between the bytes of a frame (milliseconds)
+#define REMOTE_BYTE_MS 50
+
+// message types
+#define REMOTE_HELLO			0x00	// sent on entering, payload: version
+#define REMOTE_NEW_GAME			0x01
+#define REMOTE_PLACE			0x02
+#define REMOTE_GET_MOVES		0x03
+#define REMOTE_GET_POSITION		0x04
+#define REMOTE_GET_STATS		0x05
+#define REMOTE_COMPUTER_MOVE	0x06
+#define REMOTE_EXIT				0x07
+#define REMOTE_REPLY			0x80	// set in the type of a reply
+#define REMOTE_ERROR			0xFF
+
+#define REMOTE_VERSION 1
+
+// error codes
+#define REMOTE_ERROR_CRC		1	// the frame was damaged
+#define REMOTE_ERROR_LENGTH		2	// the payload is the wrong length
+#define REMOTE_ERROR_COMMAND	3	// there is no such command
+#define REMOTE_ERROR_ILLEGAL	4	// the move is not legal
+#define REMOTE_ERROR_GAME_OVER	5	// the game is over, there is no move
+
+// enter remote mode (call this when REMOTE_ENQ has been read), returns
+// when it is left. The game in progress is replaced, and the terminal
+// has to be redrawn afterwards.
+void run_remote(void);
+
+#endif /* REMOTE_H_ */
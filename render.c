@@ -0,0 +1,181 @@
+/*
+ * render.c
+ *
+ * Draws the board and the scores once per frame. What each square should
+ * show is kept here along with a bit for each square which has changed
+ * since it was last drawn (a byte per row), so a square which changes
+ * several times between frames is only drawn once, as it ends up. A frame
+ * draws any lines of the empty board still to be drawn, then the changed
+ * squares from the top row down and left to right, which keeps the cursor
+ * moves between them short, then the scores, and last the squares which
+ * only the cursor blinking has changed.
+ */
+
+#include <stdint.h>
+
+#include "render.h"
+#include "display.h"
+#include "scoring.h"
+#include "serialio.h"
+#include "timer0.h"
+
+// the most bytes drawing a square can take (colour, cursor move, two
+// spaces), drawing a line of the board (hiding the terminal's cursor for
+// the first line, colour, cursor move, the line) and drawing the scores
+// (two cursor moves and lines, and the colours being reset)
+#define SQUARE_BYTES 18
+#define BOARD_LINE_BYTES 48
+#define SCORE_BYTES 52
+
+// what each square should show, indexed by y*WIDTH+x
+static uint8_t wanted[WIDTH * HEIGHT];
+// the squares of each row (bit x) which have to be drawn, and those
+// which only the cursor has changed
+static uint8_t dirty_rows[HEIGHT];
+static uint8_t cursor_rows[HEIGHT];
+static uint8_t score_dirty;
+// the next line of the empty board to draw (BOARD_LINES once it is done)
+static uint8_t board_line;
+
+static uint32_t last_frame_time;
+
+// cleared while something else has the serial port
+static uint8_t enabled = 1;
+
+static render_stats_t stats;
+
+void render_init(void) {
+	for (uint8_t sq = 0; sq < WIDTH * HEIGHT; sq++) {
+		wanted[sq] = EMPTY_SQUARE;
+	}
+	for (uint8_t y = 0; y < HEIGHT; y++) {
+		dirty_rows[y] = 0;
+		cursor_rows[y] = 0;
+	}
+	score_dirty = 0;
+	board_line = 0;
+}
+
+void render_square(uint8_t x, uint8_t y, uint8_t object) {
+	wanted[y * WIDTH + x] = object;
+	dirty_rows[y] |= 1 << x;
+}
+
+void render_squares(uint64_t squares, uint8_t object) {
+	for (uint8_t sq = 0; squares; sq++, squares >>= 1) {
+		if (squares & 1) {
+			render_square(sq % WIDTH, sq / WIDTH, object);
+		}
+	}
+}
+
+void render_cursor_square(uint8_t x, uint8_t y, uint8_t object) {
+	wanted[y * WIDTH + x] = object;
+	cursor_rows[y] |= 1 << x;
+}
+
+void render_score(void) {
+	score_dirty = 1;
+}
+
+static uint8_t anything_dirty(void) {
+	uint8_t dirty = score_dirty || board_line < BOARD_LINES;
+	for (uint8_t y = 0; y < HEIGHT; y++) {
+		dirty |= dirty_rows[y] | cursor_rows[y];
+	}
+	return dirty;
+}
+
+// check there is room for 'bytes' of output of the given priority, if
+// 'limited' is not set there always is (the output waits for it)
+static uint8_t room_for(uint8_t limited, uint8_t priority, uint8_t bytes) {
+	return !limited || serial_tx_headroom(priority) >= bytes;
+}
+
+// draw the squares marked in 'rows' (a byte per row), clearing their
+// marks, while there is room for them. Returns 0 if it ran out of room.
+static uint8_t draw_squares(uint8_t *rows, uint8_t limited, uint8_t priority) {
+	// the terminal shows the top row (the highest y) first
+	for (int8_t y = HEIGHT - 1; y >= 0; y--) {
+		for (uint8_t x = 0; x < WIDTH && rows[y]; x++) {
+			if (!(rows[y] & (1 << x))) {
+				continue;
+			}
+			if (!room_for(limited, priority, SQUARE_BYTES)) {
+				return 0;
+			}
+			update_square_colour(x, y, wanted[y * WIDTH + x]);
+			// the square is up to date, whatever marked it
+			dirty_rows[y] &= ~(1 << x);
+			cursor_rows[y] &= ~(1 << x);
+		}
+	}
+	return 1;
+}
+
+// draw what has been marked, if 'limited' is set stop when the output
+// buffer has no room left for more
+static void draw(uint8_t limited) {
+	uint32_t start_bytes = serial_bytes_sent();
+
+	// the squares go inside the board, so it has to be finished first
+	while (board_line < BOARD_LINES
+			&& room_for(limited, SERIAL_PRIORITY_HIGH, BOARD_LINE_BYTES)) {
+		draw_board_line(board_line++);
+	}
+	if (board_line == BOARD_LINES && draw_squares(dirty_rows, limited, SERIAL_PRIORITY_HIGH)) {
+		if (score_dirty && room_for(limited, SERIAL_PRIORITY_HIGH, SCORE_BYTES)) {
+			display_scores();
+			score_dirty = 0;
+		}
+		if (!draw_squares(cursor_rows, limited, SERIAL_PRIORITY_LOW)) {
+			stats.cursor_deferred++;
+		}
+	}
+
+	uint32_t bytes = serial_bytes_sent() - start_bytes;
+	if (bytes > stats.max_frame_bytes) {
+		stats.max_frame_bytes = bytes;
+	}
+	stats.frames++;
+}
+
+uint8_t render_frame(void) {
+	uint32_t current_time = get_current_time();
+	if (current_time - last_frame_time < RENDER_FRAME_MS) {
+		return 0;
+	}
+	last_frame_time = current_time;
+	if (!enabled || !anything_dirty()) {
+		return 0;
+	}
+	if (serial_tx_free() < RENDER_MIN_TX_FREE) {
+		stats.frames_skipped++;
+		return 0;
+	}
+	draw(1);
+	return 1;
+}
+
+void render_flush(void) {
+	if (enabled && anything_dirty()) {
+		draw(0);
+	}
+}
+
+void render_wake_time(uint32_t *wake_time) {
+	if (enabled && anything_dirty()) {
+		uint32_t due = last_frame_time + RENDER_FRAME_MS;
+		if ((int32_t)(due - *wake_time) < 0) {
+			*wake_time = due;
+		}
+	}
+}
+
+void render_set_enabled(uint8_t enable) {
+	enabled = enable;
+}
+
+const render_stats_t *get_render_stats(void) {
+	return &stats;
+}
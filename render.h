@@ -0,0 +1,80 @@
+/*
+ * render.h
+ *
+ * Draws the board and the scores on the terminal at a steady frame rate.
+ * The game only marks what has changed (board squares, the cursor, which
+ * is drawn as a square, and the score panel) and render_frame(), called
+ * from the main loop, sends all of it at once in a single ordered update.
+ *
+ * Nothing the renderer draws ever waits for the serial port. The empty
+ * board, the squares and the scores must all get through and may use the
+ * whole output buffer; the cursor blinking is low priority and is left
+ * for a later frame (where it may be overtaken by the next blink) when
+ * the buffer is getting full.
+ */
+
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include <stdint.h>
+
+// time between frames (milliseconds), about 30 frames a second
+#ifndef RENDER_FRAME_MS
+#define RENDER_FRAME_MS 33
+#endif
+
+// a frame is left out if the serial output buffer has less room than
+// this, so that drawing never has to wait for the serial port
+#ifndef RENDER_MIN_TX_FREE
+#define RENDER_MIN_TX_FREE 64
+#endif
+
+// counts of the frames drawn since the program started
+typedef struct {
+	uint32_t frames;			// frames in which something was drawn
+	uint32_t frames_skipped;	// frames left out as the output was backed up
+	uint16_t max_frame_bytes;	// the most bytes sent in one frame
+	uint32_t cursor_deferred;	// cursor squares left for a later frame
+} render_stats_t;
+
+// forget anything waiting to be drawn and draw an empty board (all
+// squares EMPTY_SQUARE), call this after initialise_display()
+void render_init(void);
+
+// mark square (x, y) to be drawn as 'object' (see display.h)
+void render_square(uint8_t x, uint8_t y, uint8_t object);
+
+// mark every square whose bit is set in 'squares' (bit y*WIDTH+x for
+// square (x, y)) to be drawn as 'object'
+void render_squares(uint64_t squares, uint8_t object);
+
+// mark square (x, y) to be drawn as 'object' for the cursor blinking, at
+// low priority (see above)
+void render_cursor_square(uint8_t x, uint8_t y, uint8_t object);
+
+// mark the scores to be redrawn
+void render_score(void);
+
+// call this from the main loop, once a frame time has passed it draws
+// whatever has been marked. Returns 1 if a frame was drawn, 0 if not.
+// A frame only sends as much as fits in the output buffer, the rest is
+// left for the next one.
+uint8_t render_frame(void);
+
+// draw everything that has been marked now, waiting for the serial port
+// if need be (e.g. before a long computer search)
+void render_flush(void);
+
+// if something is waiting to be drawn and its frame is due before
+// '*wake_time', set it to when the frame is due
+void render_wake_time(uint32_t *wake_time);
+
+// turn drawing off (0) or back on (1). While it is off nothing is sent to
+// the terminal, so the serial port can be used for something else (see
+// remote.h). The board has to be set up again afterwards.
+void render_set_enabled(uint8_t enabled);
+
+// returns the counts of frames since the program started
+const render_stats_t *get_render_stats(void);
+
+#endif /* RENDER_H_ */
@@ -0,0 +1,168 @@
+/*
+ * scheduler.c
+ *
+ * The timing wheel: SCHEDULER_WHEEL_SIZE lists of tasks, a task going in
+ * the list (slot) for the millisecond it is due at, modulo the size of
+ * the wheel. scheduler_run() looks at the slot of each millisecond which
+ * has gone by since it last ran and takes off the tasks which are due;
+ * the others there are due a turn or more of the wheel later. If it
+ * hasn't run for a whole turn of the wheel it looks at every slot once.
+ *
+ * The lists are doubly linked, each task keeping the link which points
+ * to it, so a task can be taken off whichever list it is on without
+ * looking for it.
+ */
+
+#include <stdint.h>
+
+#include "scheduler.h"
+#include "timer0.h"
+#include "timer1.h"
+
+#define WHEEL_MASK (SCHEDULER_WHEEL_SIZE - 1)
+
+static scheduler_task_t *wheel[SCHEDULER_WHEEL_SIZE];
+// the last millisecond whose slot has been looked at
+static uint32_t wheel_time;
+// the tasks taken off the wheel by scheduler_run() which have not run yet
+static scheduler_task_t *due_tasks;
+// every task which has been started
+static scheduler_task_t *started_tasks;
+
+static void list_add(scheduler_task_t **list, scheduler_task_t *task) {
+	task->next = *list;
+	if (task->next) {
+		task->next->link = &task->next;
+	}
+	task->link = list;
+	*list = task;
+}
+
+static void list_remove(scheduler_task_t *task) {
+	*task->link = task->next;
+	if (task->next) {
+		task->next->link = task->link;
+	}
+	task->link = 0;
+}
+
+static void add_to_wheel(scheduler_task_t *task) {
+	// a task due in a millisecond whose slot has already been looked at
+	// goes in the next slot to be looked at
+	uint32_t slot_time = task->due;
+	if ((int32_t)(slot_time - wheel_time) <= 0) {
+		slot_time = wheel_time + 1;
+	}
+	list_add(&wheel[slot_time & WHEEL_MASK], task);
+}
+
+void scheduler_init(void) {
+	for (uint8_t slot = 0; slot < SCHEDULER_WHEEL_SIZE; slot++) {
+		wheel[slot] = 0;
+	}
+	due_tasks = 0;
+	for (scheduler_task_t *task = started_tasks; task; task = task->next_started) {
+		task->link = 0;
+		task->started = 0;
+	}
+	started_tasks = 0;
+	wheel_time = get_current_time();
+}
+
+void scheduler_start(scheduler_task_t *task, const char *name,
+		void (*callback)(void), uint16_t delay_ms, uint16_t period_ms) {
+	scheduler_cancel(task);
+	task->callback = callback;
+	task->name = name;
+	task->period_ms = period_ms;
+	task->due = get_current_time() + delay_ms;
+	if (!task->started) {
+		scheduler_stats_t no_stats = { 0 };
+		task->stats = no_stats;
+		task->started = 1;
+		task->next_started = started_tasks;
+		started_tasks = task;
+	}
+	add_to_wheel(task);
+}
+
+void scheduler_cancel(scheduler_task_t *task) {
+	if (task->link) {
+		list_remove(task);
+	}
+}
+
+uint8_t scheduler_run(void) {
+	// take the tasks which are due off the wheel
+	uint32_t now = get_current_time();
+	uint32_t elapsed = now - wheel_time;
+	uint8_t slots = (elapsed < SCHEDULER_WHEEL_SIZE) ? elapsed : SCHEDULER_WHEEL_SIZE;
+	while (slots--) {
+		wheel_time++;
+		scheduler_task_t *task = wheel[wheel_time & WHEEL_MASK];
+		while (task) {
+			scheduler_task_t *next = task->next;
+			if ((int32_t)(now - task->due) >= 0) {
+				list_remove(task);
+				list_add(&due_tasks, task);
+			}
+			task = next;
+		}
+	}
+	wheel_time = now;
+
+	// and run them. A task can cancel another which is due (taking it
+	// off this list), so the list is only ever read from its start.
+	uint8_t run = 0;
+	while (due_tasks) {
+		scheduler_task_t *task = due_tasks;
+		list_remove(task);
+		uint32_t start_time = get_current_time();
+		uint32_t late = start_time - task->due;
+
+		// a periodic task goes back on the wheel first, so that it can
+		// cancel or restart itself
+		if (task->period_ms) {
+			task->due += task->period_ms;
+			if ((int32_t)(start_time - task->due) >= 0) {
+				task->due = start_time + task->period_ms;
+			}
+			add_to_wheel(task);
+		}
+
+		uint32_t start_cycles = get_cycle_count();
+		task->callback();
+		uint32_t cycles = get_cycle_count() - start_cycles;
+
+		scheduler_stats_t *stats = &task->stats;
+		stats->runs++;
+		stats->total_cycles += cycles;
+		if (cycles > stats->max_cycles) {
+			stats->max_cycles = cycles;
+		}
+		stats->total_late_ms += late;
+		if (late > stats->max_late_ms) {
+			stats->max_late_ms = (late > 0xFFFF) ? 0xFFFF : late;
+		}
+		run++;
+	}
+	return run;
+}
+
+void scheduler_wake_time(uint32_t *wake_time) {
+	for (uint8_t slot = 0; slot < SCHEDULER_WHEEL_SIZE; slot++) {
+		for (scheduler_task_t *task = wheel[slot]; task; task = task->next) {
+			if ((int32_t)(task->due - *wake_time) < 0) {
+				*wake_time = task->due;
+			}
+		}
+	}
+}
+
+const scheduler_task_t *scheduler_first_task(void) {
+	return started_tasks;
+}
+
+const scheduler_task_t *scheduler_next_task(const scheduler_task_t *task) {
+	return task->next_started;
+}
@@ -0,0 +1,82 @@
+/*
+ * scheduler.h
+ *
+ * Software timers on top of timer 0's millisecond clock. A task is a
+ * function to be called once after a delay, or over and over with a
+ * period between the calls. The functions are called from the main loop
+ * by scheduler_run(), never from an interrupt handler, so they can do
+ * anything the rest of the program can (draw, print, read the game).
+ *
+ * The timers are kept in a hashed timing wheel (see scheduler.c), so
+ * starting and cancelling a task take the same short time however many
+ * there are. The scheduler keeps no memory of its own for them: each
+ * task is a scheduler_task_t the caller keeps (usually a static one).
+ *
+ * Like the clock, the timers stand still while the game is paused.
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+
+// the number of slots in the wheel (a power of two). A task due within
+// this many milliseconds is only looked at in its own millisecond.
+#ifndef SCHEDULER_WHEEL_SIZE
+#define SCHEDULER_WHEEL_SIZE 16
+#endif
+
+// how each task has run since it was first started
+typedef struct {
+	uint16_t runs;
+	uint32_t total_cycles;		// time spent in the task (clock cycles)
+	uint32_t max_cycles;
+	uint32_t total_late_ms;		// how long after it was due it ran
+	uint16_t max_late_ms;
+} scheduler_stats_t;
+
+typedef struct scheduler_task {
+	void (*callback)(void);
+	const char *name;			// in program memory
+	uint32_t due;				// get_current_time() it is due at
+	uint16_t period_ms;			// 0 for a task which runs once
+	// the list the task is on (a slot of the wheel, or the tasks due
+	// now), with the link which points to it, or 0 if it is on none
+	struct scheduler_task *next;
+	struct scheduler_task **link;
+	// every task which has been started, for the statistics
+	struct scheduler_task *next_started;
+	uint8_t started;
+	scheduler_stats_t stats;
+} scheduler_task_t;
+
+// forget every task, call this once timer 0 has been set up
+void scheduler_init(void);
+
+// start 'task', which calls 'callback' after 'delay_ms' milliseconds, and
+// then every 'period_ms' milliseconds if that isn't 0. 'name' (in program
+// memory) is shown with the statistics. A task which was already started
+// is started again from now.
+void scheduler_start(scheduler_task_t *task, const char *name,
+		void (*callback)(void), uint16_t delay_ms, uint16_t period_ms);
+
+// stop 'task' (if it is started), it can be started again later. A task
+// may cancel itself, or others, from its callback.
+void scheduler_cancel(scheduler_task_t *task);
+
+// call this from the main loop, it runs every task which is due. A task
+// which was more than a period late runs only once, and then a period
+// after it ran rather than after it was due. Returns the number run.
+uint8_t scheduler_run(void);
+
+// if a task is due before '*wake_time', set it to when the first one is
+// due (for working out how long the main loop can sleep)
+void scheduler_wake_time(uint32_t *wake_time);
+
+// return the first task started (the most recently started one), and
+// the next after 'task', for going through the statistics. Each returns
+// 0 once there are no more.
+const scheduler_task_t *scheduler_first_task(void);
+const scheduler_task_t *scheduler_next_task(const scheduler_task_t *task);
+
+#endif /* SCHEDULER_H_ */
@@ -6,56 +6,51 @@
  */ 
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <stdint.h>
 #include <stdio.h>
 
 #include "terminalio.h"
 #include "display.h"
 #include "game.h"
+#include "render.h"
+#include "scoring.h"
+#include "timer0.h"
 
 
 // scores of two players
 uint8_t redScore;
 uint8_t greenScore;
 
-void init_score(void) {	
-	
-	// At the beginning of game, every players have two piece on board
-	redScore = 2;
-	greenScore = 2;
-	
-	// display scores of two players
+void display_scores(void) {
 	move_terminal_cursor(2, 2);
-	printf("Red Score:%6d", (int)redScore);
+	term_print_P(PSTR("Red Score:"));
+	term_print_number(redScore, 6);
 	move_terminal_cursor(2, 3);
-	printf("Green score:%4d", (int)greenScore);
+	term_print_P(PSTR("Green score:"));
+	term_print_number(greenScore, 4);
 }
 
-void piece_placement_score(uint8_t player) {
-	if (player == PLAYER_1) { // when player 1 places a piece successfully
-		redScore += 1;
-		move_terminal_cursor(2, 2);
-		printf("Red Score:%6d", (int)redScore);
-		move_terminal_cursor(2, 3);
-		printf("Green score:%4d", (int)greenScore);
-	} else if (player == PLAYER_2) { // when player 2 places a piece successfully
-		greenScore += 1;
-		move_terminal_cursor(2, 2);
-		printf("Red Score:%6d", (int)redScore);
-		move_terminal_cursor(2, 3);
-		printf("Green score:%4d", (int)greenScore);
-	}
+void init_score(void) {	
+	
+	// At the beginning of game, every players have two piece on board
+	redScore = get_piece_count(PLAYER_1);
+	greenScore = get_piece_count(PLAYER_2);
 	
+	// display scores of two players (with the next frame)
+	render_score();
+	set_seven_seg_number(get_score());
 }
 
-void flip_piece_score(uint8_t player){
-	if (player == PLAYER_1) {
-		redScore++;
-		greenScore--;
-	} else {
-		redScore--;
-		greenScore++;
-	}
+void update_score(void) {
+	// the scores are just the number of pieces each player has on the
+	// board, so read them back from the board after every placement
+	redScore = get_piece_count(PLAYER_1);
+	greenScore = get_piece_count(PLAYER_2);
+	render_score();
+	// the seven segment display shows the score of the player to move,
+	// which has changed with the move (and with the turn passing)
+	set_seven_seg_number(get_score());
 }
 
 uint8_t get_score(void) {
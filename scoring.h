@@ -12,11 +12,13 @@
 // initialise scores of two players
 void init_score(void);
 
-// change the score if a player place a piece successfully
-void piece_placement_score(uint8_t player);
+// recount the scores from the board after a piece has been placed
+// (and any pieces flipped) and update the display of them
+void update_score(void);
 
-// change the score if a player flips another player's piece
-void flip_piece_score(uint8_t player);
+// redraw both players' scores on the terminal now (the renderer calls
+// this, the functions above only mark the scores to be redrawn)
+void display_scores(void);
 
 // return current score of players 
 uint8_t get_score(void);
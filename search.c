@@ -0,0 +1,307 @@
+/*
+ * search.c
+ *
+ * Computer player for Reversi. An alpha-beta search in negamax form is
+ * run with iterative deepening: depth 1, then depth 2 and so on, until
+ * the time budget is used up. The move found by the last iteration that
+ * was completed is played.
+ *
+ * Only one position is ever used. Moves are made and unmade on it with
+ * make_move()/unmake_move() so each ply of the search only costs an
+ * undo record and a few locals of stack.
+ *
+ * Results are kept in the transposition table (ttable.c) by the Zobrist
+ * hash that make_move() maintains. The table supplies the move to try
+ * first in each position, and sometimes a score that makes searching
+ * the position again unnecessary.
+ *
+ * With few enough empty squares left the endgame solver (endgame.c) is
+ * given most of the time budget first. If it finishes its move is played,
+ * otherwise the ordinary search uses whatever time is left.
+ */
+
+#include <stdint.h>
+
+#include "search.h"
+#include "game.h"
+#include "endgame.h"
+#include "timer0.h"
+#include "ttable.h"
+
+// scores of finished games are pushed outside the range of the
+// evaluation so that a won game is always preferred to a good position
+#define WIN_SCORE		10000
+#define INFINITE_SCORE	32000
+
+// the clock is only checked every (TIME_CHECK_MASK + 1) nodes as it
+// disables interrupts to read it
+#define TIME_CHECK_MASK 63
+
+// groups of squares used by the evaluation and for move ordering
+#define CORNERS		0x8100000000000081ULL
+#define X_SQUARES	0x0042000000004200ULL
+#define C_SQUARES	0x4281000000008142ULL
+#define EDGES		0x3C0081818181003CULL
+#define NOT_FILE_A	0xFEFEFEFEFEFEFEFEULL
+#define NOT_FILE_H	0x7F7F7F7F7F7F7F7FULL
+
+// evaluation weights
+#define CORNER_WEIGHT		25
+#define X_SQUARE_WEIGHT		12
+#define C_SQUARE_WEIGHT		5
+#define EDGE_WEIGHT			2
+#define MOBILITY_WEIGHT		4
+
+// moves are tried in this many groups, see move_group()
+#define MOVE_GROUPS 5
+
+// the share of the time budget the endgame solver may use, in quarters
+#define ENDGAME_BUDGET_QUARTERS 3
+
+static ENGINE_TLS uint32_t deadline;
+static ENGINE_TLS uint32_t nodes;
+static ENGINE_TLS uint8_t aborted;
+
+// the deepest iteration to attempt
+static ENGINE_TLS uint8_t depth_limit = SEARCH_MAX_DEPTH;
+
+// the difference between two piece counts
+static inline int8_t count_difference(bitboard_t own, bitboard_t opp) {
+	return (int8_t)count_bits(own) - (int8_t)count_bits(opp);
+}
+
+// score of a finished game from the point of view of the player to move
+static int16_t final_score(const position_t *pos) {
+	int8_t diff = count_difference(pos->pieces[pos->side], pos->pieces[pos->side ^ 1]);
+	if (diff > 0) {
+		return WIN_SCORE + diff;
+	} else if (diff < 0) {
+		return -WIN_SCORE + diff;
+	}
+	return 0;
+}
+
+int16_t evaluate_position(const position_t *pos) {
+	bitboard_t own = pos->pieces[pos->side];
+	bitboard_t opp = pos->pieces[pos->side ^ 1];
+	int16_t score = 0;
+
+	// corners can never be flipped back
+	score += CORNER_WEIGHT * count_difference(own & CORNERS, opp & CORNERS);
+
+	// the squares next to a corner are bad to hold while the corner is
+	// still empty as they let the opponent take it
+	bitboard_t empty_corners = CORNERS & ~(own | opp);
+	bitboard_t x_risk = X_SQUARES & ((empty_corners << 9) | (empty_corners << 7)
+			| (empty_corners >> 7) | (empty_corners >> 9));
+	bitboard_t c_risk = C_SQUARES & ((empty_corners << 8) | (empty_corners >> 8)
+			| ((empty_corners << 1) & NOT_FILE_A) | ((empty_corners >> 1) & NOT_FILE_H));
+	score -= X_SQUARE_WEIGHT * count_difference(own & x_risk, opp & x_risk);
+	score -= C_SQUARE_WEIGHT * count_difference(own & c_risk, opp & c_risk);
+	score += EDGE_WEIGHT * count_difference(own & EDGES, opp & EDGES);
+
+	// having more moves to choose from than the opponent is good
+	score += MOBILITY_WEIGHT * count_difference(generate_moves(own, opp),
+			generate_moves(opp, own));
+	return score;
+}
+
+// returns the moves from one of the ordering groups. Group 0 is the
+// hint move (from the table or the previous iteration) on its own, then
+// come the other moves, corners first and squares next to the corners last
+static inline bitboard_t move_group(bitboard_t moves, uint8_t hint, uint8_t group) {
+	bitboard_t hint_bit = (hint < PASS_MOVE) ? SQUARE_BIT(hint) & moves : 0;
+	moves &= ~hint_bit;
+	switch (group) {
+		case 0:		return hint_bit;
+		case 1:		return moves & CORNERS;
+		case 2:		return moves & ~(CORNERS | X_SQUARES | C_SQUARES);
+		case 3:		return moves & C_SQUARES;
+		default:	return moves & X_SQUARES;
+	}
+}
+
+// returns the lowest numbered square in a non-empty bitboard
+static inline uint8_t first_square(bitboard_t squares) {
+	return (uint8_t)__builtin_ctzll(squares);
+}
+
+static int16_t negamax(position_t *pos, uint8_t depth, int16_t alpha,
+		int16_t beta, uint8_t passed) {
+	// stop as soon as the time has run out, the result of an unfinished
+	// iteration is thrown away so the value returned does not matter
+	if ((++nodes & TIME_CHECK_MASK) == 0 && get_current_time() >= deadline) {
+		aborted = 1;
+	}
+	if (aborted) {
+		return 0;
+	}
+
+	bitboard_t moves = legal_moves(pos);
+	if (!moves) {
+		// two passes in a row means the game is over
+		if (passed) {
+			return final_score(pos);
+		}
+		undo_t undo = make_move(pos, PASS_MOVE);
+		int16_t score = -negamax(pos, depth, -beta, -alpha, 1);
+		unmake_move(pos, &undo);
+		return score;
+	}
+	if (depth == 0) {
+		return evaluate_position(pos);
+	}
+
+	// the table may already know the answer, and if not it can still
+	// tell us which move was best last time
+	uint8_t hint = NO_TT_MOVE;
+	const tt_entry_t *entry = tt_probe(pos->hash);
+	if (entry) {
+		hint = entry->move;
+		if (entry->depth >= depth) {
+			uint8_t bound = TT_BOUND(entry);
+			if (bound == TT_EXACT || (bound == TT_LOWER && entry->score >= beta)
+					|| (bound == TT_UPPER && entry->score <= alpha)) {
+				tt_count_cutoff();
+				return entry->score;
+			}
+		}
+	}
+
+	int16_t original_alpha = alpha;
+	int16_t best = -INFINITE_SCORE;
+	uint8_t best_move = NO_TT_MOVE;
+	for (uint8_t group = 0; group < MOVE_GROUPS && alpha < beta; group++) {
+		bitboard_t group_moves = move_group(moves, hint, group);
+		while (group_moves) {
+			uint8_t sq = first_square(group_moves);
+			group_moves &= group_moves - 1;
+
+			undo_t undo = make_move(pos, sq);
+			int16_t score = -negamax(pos, depth - 1, -beta, -alpha, 0);
+			unmake_move(pos, &undo);
+
+			if (score > best) {
+				best = score;
+				best_move = sq;
+				if (score > alpha) {
+					alpha = score;
+					if (alpha >= beta) {
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	if (!aborted) {
+		uint8_t bound = TT_EXACT;
+		if (best <= original_alpha) {
+			bound = TT_UPPER;
+		} else if (best >= beta) {
+			bound = TT_LOWER;
+		}
+		tt_store(pos->hash, depth, best, bound, best_move);
+	}
+	return best;
+}
+
+// search every root move to the given depth, the move found best by the
+// previous iteration is tried first. Returns the score of the best move
+// and stores the move in *best_move
+static int16_t search_root(position_t *pos, uint8_t depth, bitboard_t moves,
+		uint8_t *best_move) {
+	int16_t alpha = -INFINITE_SCORE;
+	uint8_t hint = *best_move;
+
+	for (uint8_t group = 0; group < MOVE_GROUPS; group++) {
+		bitboard_t group_moves = move_group(moves, hint, group);
+		while (group_moves) {
+			uint8_t sq = first_square(group_moves);
+			group_moves &= group_moves - 1;
+
+			undo_t undo = make_move(pos, sq);
+			int16_t score = -negamax(pos, depth - 1, -INFINITE_SCORE, -alpha, 0);
+			unmake_move(pos, &undo);
+			if (aborted) {
+				return alpha;
+			}
+			if (score > alpha) {
+				alpha = score;
+				*best_move = sq;
+			}
+		}
+	}
+	return alpha;
+}
+
+void search_new_game(void) {
+	tt_clear();
+}
+
+void search_set_depth_limit(uint8_t depth) {
+	depth_limit = (depth == 0 || depth > SEARCH_MAX_DEPTH) ? SEARCH_MAX_DEPTH : depth;
+}
+
+search_result_t search_best_move(position_t *pos, uint16_t time_budget_ms) {
+	search_result_t result;
+	uint32_t start_time = get_current_time();
+	deadline = start_time + time_budget_ms;
+	nodes = 0;
+	aborted = 0;
+	tt_new_search();
+	tt_stats_t tt_before = *tt_get_stats();
+
+	bitboard_t moves = legal_moves(pos);
+	result.best_move = moves ? first_square(moves) : PASS_MOVE;
+	result.depth = 0;
+	result.score = 0;
+	result.solved = SEARCH_HEURISTIC;
+	uint8_t empties = count_empties(pos);
+
+	// close to the end the result of the game can be worked out exactly
+	if ((moves & (moves - 1)) && empties <= ENDGAME_WLD_EMPTIES) {
+		uint8_t mode = (empties <= ENDGAME_EMPTIES) ? ENDGAME_EXACT : ENDGAME_WLD;
+		endgame_result_t solve = solve_endgame(pos, mode,
+				(uint32_t)time_budget_ms * ENDGAME_BUDGET_QUARTERS / 4);
+		nodes = solve.nodes;
+		if (solve.solved) {
+			result.best_move = solve.best_move;
+			result.score = solve.score;
+			result.depth = empties;
+			result.solved = (mode == ENDGAME_EXACT) ? SEARCH_EXACT : SEARCH_WLD;
+		}
+	}
+
+	// there is nothing to think about unless there is a choice of moves
+	if (result.solved == SEARCH_HEURISTIC && (moves & (moves - 1))) {
+		uint8_t best_move = result.best_move;
+		for (uint8_t depth = 1; depth <= depth_limit; depth++) {
+			int16_t score = search_root(pos, depth, moves, &best_move);
+			if (aborted) {
+				break;
+			}
+			result.best_move = best_move;
+			result.score = score;
+			result.depth = depth;
+
+			// stop once the result of the game is known, or when the
+			// next iteration (which takes several times longer than
+			// this one) would not have time to finish
+			if (depth >= empties || score >= WIN_SCORE || score <= -WIN_SCORE) {
+				break;
+			}
+			if (2 * (get_current_time() - start_time) > time_budget_ms) {
+				break;
+			}
+		}
+	}
+
+	result.nodes = nodes;
+	result.time_ms = get_current_time() - start_time;
+	const tt_stats_t *tt_after = tt_get_stats();
+	result.tt_probes = tt_after->probes - tt_before.probes;
+	result.tt_hits = tt_after->hits - tt_before.hits;
+	result.tt_cutoffs = tt_after->cutoffs - tt_before.cutoffs;
+	return result;
+}
@@ -0,0 +1,58 @@
+/*
+ * search.h
+ *
+ * Computer player for Reversi. The best move is found with an alpha-beta
+ * (negamax) search which is deepened one ply at a time until the time
+ * budget given to it has run out.
+ */
+
+#ifndef SEARCH_H_
+#define SEARCH_H_
+
+#include <stdint.h>
+
+#include "game.h"
+
+// the deepest iteration the search will ever attempt
+#define SEARCH_MAX_DEPTH 32
+
+// how the move was chosen
+#define SEARCH_HEURISTIC	0	// searched to a limited depth and evaluated
+#define SEARCH_EXACT		1	// solved to the end of the game
+#define SEARCH_WLD			2	// solved to the end for win/loss/draw only
+
+// statistics from a search, along with the move it chose
+typedef struct {
+	uint8_t best_move;	// the square to play, or PASS_MOVE
+	uint8_t depth;		// the deepest iteration that was completed
+	int16_t score;		// the score of best_move from the mover's point of view
+	uint8_t solved;		// SEARCH_HEURISTIC, or SEARCH_EXACT/SEARCH_WLD when
+						// the endgame solver worked out the result of the
+						// game, score is then the final disc difference (or
+						// just its sign)
+	uint32_t nodes;		// positions visited
+	uint32_t time_ms;	// how long the search took
+	uint32_t tt_probes;	// transposition table lookups
+	uint32_t tt_hits;	// lookups which found the position
+	uint32_t tt_cutoffs;	// hits which saved searching the position again
+} search_result_t;
+
+// find the best move for the player to move in pos, taking no more than
+// (roughly) time_budget_ms milliseconds. Near the end of the game the
+// endgame solver (endgame.c) is tried first. pos is used as scratch space
+// while searching but is returned unchanged
+search_result_t search_best_move(position_t *pos, uint16_t time_budget_ms);
+
+// stop deepening the search after this many plies, even if there is
+// time left (0 for no limit other than SEARCH_MAX_DEPTH). The endgame
+// solver is not affected
+void search_set_depth_limit(uint8_t depth);
+
+// forget everything learnt in earlier games, call this when a new game starts
+void search_new_game(void);
+
+// score a position from the point of view of the player to move, a
+// positive score is good for that player
+int16_t evaluate_position(const position_t *pos);
+
+#endif /* SEARCH_H_ */
@@ -18,6 +18,10 @@
  * The function input_available() can be used to test whether there is
  * input available to read from stdin.
  *
+ * Each circular buffer has exactly one writer and one reader (the main
+ * program and an interrupt handler) and each of its two positions is
+ * only changed by one of them, so neither side has to turn interrupts
+ * off to use it (see below).
  */
 
 #include <stdio.h>
@@ -25,44 +29,105 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "serialio.h"
+#include "idle.h"
 
 /* System clock rate in Hz. (L at the end indicates this is a long constant) */
 #define SYSCLK 16000000L
 
 /* Global variables */
-/* Circular buffer to hold outgoing characters. The insert_pos variable
- * keeps track of the position (0 to OUTPUT_BUFFER_SIZE-1) that the next
- * outgoing character should be written to. bytes_in_buffer keeps
- * count of the number of characters currently stored in the buffer 
- * (ranging from 0 to OUTPUT_BUFFER_SIZE). This number of bytes immediately
- * prior to the current insert_pos are the bytes waiting to be output.
- * If the insert_pos reaches the end of the buffer it will wrap around
- * to the beginning (assuming those bytes have been output).
- * NOTE - OUTPUT_BUFFER_SIZE can not be larger than 255 without changing
- * the type of the variables below (currently defined as 8 bit unsigned ints).
+/* Circular buffer to hold outgoing characters. The size must be a power
+ * of two no larger than 256. out_head counts the characters put in the
+ * buffer and out_tail those taken out of it. They are 8 bit counts which
+ * are left to wrap around, the position in the buffer is the count masked
+ * with OUTPUT_BUFFER_MASK, and head - tail (also wrapping around) is the
+ * number of characters waiting. The main program only ever writes
+ * out_head (after storing the character) and the interrupt handler only
+ * ever writes out_tail (after taking the character), and each is a single
+ * byte which is written in one instruction, so the other side always sees
+ * either the old or the new value and never a half changed buffer. One
+ * position is always left empty so that a full buffer can be told from
+ * an empty one when the size is 256.
  */
-#define OUTPUT_BUFFER_SIZE 255
-volatile char out_buffer[OUTPUT_BUFFER_SIZE];
-volatile uint8_t out_insert_pos;
-volatile uint8_t bytes_in_out_buffer;
+#define OUTPUT_BUFFER_SIZE 256
+#define OUTPUT_BUFFER_MASK (OUTPUT_BUFFER_SIZE - 1)
+static volatile char out_buffer[OUTPUT_BUFFER_SIZE];
+static volatile uint8_t out_head;
+static volatile uint8_t out_tail;
 
 /* Circular buffer to hold incoming characters. Works on same principle
- * as output buffer
+ * as output buffer, with the receive interrupt handler as the writer,
+ * except that every position can be used (so the size must be no larger
+ * than 128). It is large enough to hold a burst of pasted or scripted
+ * input while the main program is busy drawing.
+ */
+#define INPUT_BUFFER_SIZE 64
+#define INPUT_BUFFER_MASK (INPUT_BUFFER_SIZE - 1)
+static volatile char input_buffer[INPUT_BUFFER_SIZE];
+/* the order each character arrived in among all the input */
+static volatile uint8_t input_sequence[INPUT_BUFFER_SIZE];
+static volatile uint8_t input_head;
+static volatile uint8_t input_tail;
+
+/* Counts of characters lost on the way in: those which arrived before the
+ * last had been read from the UART (overruns) and those which found the
+ * input buffer full (dropped). Only the receive interrupt handler changes
+ * them.
+ */
+static volatile serial_rx_stats_t rx_stats;
+
+#if SERIAL_XON_XOFF
+/* Flow control: the sender is sent XOFF when the input buffer is
+ * XOFF_LEVEL characters full, leaving room for what it sends before it
+ * stops, and XON when the buffer has emptied to XON_LEVEL again. The
+ * transmit interrupt handler decides when to send them (so it is the only
+ * one to change rx_stopped) and the other handlers just make sure it runs.
+ */
+#define XON 0x11
+#define XOFF 0x13
+#define XOFF_LEVEL (INPUT_BUFFER_SIZE * 3 / 4)
+#define XON_LEVEL (INPUT_BUFFER_SIZE / 4)
+static volatile uint8_t rx_stopped;
+#endif
+
+/* Characters to echo. Echoing from the receive interrupt handler can't
+ * use the output buffer, which only the main program writes to, so the
+ * receive handler puts them here and the transmit handler sends them
+ * ahead of the output buffer. It is the same kind of buffer, with the two
+ * handlers as its writer and reader.
  */
-#define INPUT_BUFFER_SIZE 16
-volatile char input_buffer[INPUT_BUFFER_SIZE];
-volatile uint8_t input_insert_pos;
-volatile uint8_t bytes_in_input_buffer;
-volatile uint8_t input_overrun;
+#define ECHO_BUFFER_SIZE 8
+#define ECHO_BUFFER_MASK (ECHO_BUFFER_SIZE - 1)
+static volatile char echo_buffer[ECHO_BUFFER_SIZE];
+static volatile uint8_t echo_head;
+static volatile uint8_t echo_tail;
+
+/* Count of the characters that have been put in the output buffer, i.e.
+ * the bytes sent or waiting to be, and of those echoed.
+ */
+static uint32_t bytes_sent;
+static volatile uint32_t bytes_echoed;
 
 /* Variable to keep track of whether incoming characters are to be echoed
  * back or not.
  */
 static int8_t do_echo;
 
+/* Whether input is taken as it is (see serial_set_binary()) */
+static volatile uint8_t binary_mode;
+
+/* The baud rate in use */
+static uint32_t current_baudrate;
+
+/* Set once a character has been written to the UART, from when its
+ * Transmit Complete flag can be waited on.
+ */
+static volatile uint8_t transmitted;
+
 /* Function prototypes 
  */
-void init_serial_stdio(long baudrate, int8_t echo);
 static int uart_put_char(char, FILE*);
 static int uart_get_char(FILE*);
 
@@ -77,24 +142,31 @@ void init_serial_stdio(long baudrate, int8_t echo) {
 	/*
 	 * Initialise our buffers
 	*/
-	out_insert_pos = 0;
-	bytes_in_out_buffer = 0;
-	input_insert_pos = 0;
-	bytes_in_input_buffer = 0;
-	input_overrun = 0;
+	out_head = 0;
+	out_tail = 0;
+	input_head = 0;
+	input_tail = 0;
+	rx_stats.overruns = 0;
+	rx_stats.dropped = 0;
+#if SERIAL_XON_XOFF
+	rx_stopped = 0;
+#endif
+	echo_head = 0;
+	echo_tail = 0;
 	
 	/*
 	 * Record whether we're going to echo characters or not
 	*/
 	do_echo = echo;
+	binary_mode = 0;
 	
-	/* Configure the serial port baud rate */
-	/* (This differs from the datasheet formula so that we get 
-	 * rounding to the nearest integer while using integer division
-	 * (which truncates)).
+	/* Configure the serial port baud rate. The UART runs in double
+	 * speed mode (U2X0), which gives finer steps at high rates.
 	*/
-	ubrr = ((SYSCLK / (8 * baudrate)) + 1)/2 - 1;
+	ubrr = SERIAL_UBRR(baudrate);
+	UCSR0A |= (1 << U2X0);
 	UBRR0 = ubrr;
+	current_baudrate = baudrate;
 	
 	/*
 	 * Enable transmission and receiving via UART. We don't enable
@@ -118,130 +190,279 @@ void init_serial_stdio(long baudrate, int8_t echo) {
 	stdin = &myStream;
 }
 
+void serial_flush(void) {
+	/* Wait for the buffer to empty, and then for the last character to
+	 * leave the UART. The transmit handler clears the Transmit Complete
+	 * flag as it writes each character, so the flag is only set once
+	 * the last one has been shifted out.
+	 */
+	while(out_head != out_tail) {
+		/* do nothing */
+	}
+	if(transmitted) {
+		while(!(UCSR0A & (1 << TXC0))) {
+			/* do nothing */
+		}
+	}
+}
+
+void serial_set_baud(uint32_t baudrate) {
+	/* Characters still to go would be garbled by the change */
+	serial_flush();
+	UBRR0 = SERIAL_UBRR(baudrate);
+	current_baudrate = baudrate;
+}
+
+uint32_t serial_get_baud(void) {
+	return current_baudrate;
+}
+
 int8_t serial_input_available(void) {
-	return (bytes_in_input_buffer != 0);
+	return (input_head != input_tail);
+}
+
+uint8_t serial_input_sequence(uint8_t *sequence) {
+	uint8_t tail = input_tail;
+	if(input_head == tail) {
+		return 0;
+	}
+	*sequence = input_sequence[tail & INPUT_BUFFER_MASK];
+	return 1;
+}
+
+uint32_t serial_bytes_sent(void) {
+	uint32_t count = bytes_sent;
+	if(do_echo) {
+		/* Interrupts are turned off while the 4 bytes are copied
+		 * since the receive interrupt can change the count.
+		 */
+		uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+		cli();
+		count += bytes_echoed;
+		if(interrupts_enabled) {
+			sei();
+		}
+	}
+	return count;
+}
+
+uint8_t serial_tx_free(void) {
+	return (OUTPUT_BUFFER_SIZE - 1) - (uint8_t)(out_head - out_tail);
+}
+
+uint8_t serial_tx_headroom(uint8_t priority) {
+	uint8_t free = serial_tx_free();
+	if(priority == SERIAL_PRIORITY_HIGH) {
+		return free;
+	}
+	return (free > SERIAL_TX_RESERVE) ? free - SERIAL_TX_RESERVE : 0;
+}
+
+/* Copy up to 'length' characters into the output buffer, from program
+ * memory if 'from_flash' is set, without waiting. Returns how many were
+ * taken. The head position is only moved once at the end, so the
+ * transmit interrupt handler sees them all arrive together.
+ */
+static uint8_t put_chars(const char *data, uint8_t length, uint8_t from_flash) {
+	uint8_t free = serial_tx_free();
+	if(length > free) {
+		length = free;
+	}
+	uint8_t head = out_head;
+	for(uint8_t i = 0; i < length; i++) {
+		out_buffer[head++ & OUTPUT_BUFFER_MASK] =
+				from_flash ? pgm_read_byte(data + i) : data[i];
+	}
+	out_head = head;
+	bytes_sent += length;
+
+	/* Make sure the UART Data Register Empty interrupt is enabled so
+	 * that it will fire and deal with the characters. (The handler only
+	 * ever turns this bit off, and only when it has found the buffer
+	 * empty, so it can't undo this.)
+	 */
+	UCSR0B |= (1 << UDRIE0);
+	return length;
+}
+
+/* Put all 'length' characters in the output buffer, waiting for room as
+ * uart_put_char() does.
+ */
+static void write_chars(const char *data, uint16_t length, uint8_t from_flash) {
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	while(length) {
+		uint8_t chunk = (length > 255) ? 255 : length;
+		uint8_t taken = put_chars(data, chunk, from_flash);
+		if(taken == 0 && !interrupts_enabled) {
+			/* the buffer will never empty, discard the rest */
+			return;
+		}
+		data += taken;
+		length -= taken;
+	}
+}
+
+uint8_t serial_write_nonblocking(const char *data, uint8_t length) {
+	return put_chars(data, length, 0);
+}
+
+void serial_write(const void *data, uint16_t length) {
+	write_chars(data, length, 0);
+}
+
+void serial_write_P(PGM_P data, uint16_t length) {
+	write_chars(data, length, 1);
 }
 
 void clear_serial_input_buffer(void) {
-	/* Just adjust our buffer data so it looks empty */
-	input_insert_pos = 0;
-	bytes_in_input_buffer = 0;
+	/* Just mark everything received as read */
+	input_tail = input_head;
+#if SERIAL_XON_XOFF
+	if(rx_stopped) {
+		/* let the transmit handler send XON */
+		UCSR0B |= (1 << UDRIE0);
+	}
+#endif
+}
+
+void serial_set_binary(uint8_t binary) {
+	binary_mode = binary;
+#if SERIAL_XON_XOFF
+	/* The other end stops looking for XON/XOFF in binary mode, so
+	 * forget that it was told to stop (the transmit handler sends no
+	 * flow control while binary_mode is set, so it can't change it).
+	 */
+	if(binary) {
+		rx_stopped = 0;
+	}
+#endif
+}
+
+void serial_get_rx_stats(serial_rx_stats_t *stats) {
+	/* Interrupts are turned off so both counts are copied together */
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	stats->overruns = rx_stats.overruns;
+	stats->dropped = rx_stats.dropped;
+	if(interrupts_enabled) {
+		sei();
+	}
 }
 
 static int uart_put_char(char c, FILE* stream) {
-	uint8_t interrupts_enabled;
-	
 	/* Add the character to the buffer for transmission (if there 
 	 * is space to do so). If not we wait until the buffer has space.
 	 * If the character is \n, we output \r (carriage return)
 	 * also.
 	*/
 	if(c == '\n') {
-		uart_put_char('\r', stream);
+		serial_put_byte('\r');
 	}
-	
+	serial_put_byte(c);
+	return 0;
+}
+
+void serial_put_byte(char c) {
 	/* If the buffer is full and interrupts are disabled then we
 	 * abort - we don't output the character since the buffer will
 	 * never be emptied if interrupts are disabled. If the buffer is full
 	 * and interrupts are enabled then we loop until the buffer has 
-	 * enough space. The bytes_in_buffer variable will get modified by the
+	 * enough space. out_tail will get modified by the
 	 * ISR which extracts bytes from the buffer.
 	*/
-	interrupts_enabled = bit_is_set(SREG, SREG_I);
-	while(bytes_in_out_buffer >= OUTPUT_BUFFER_SIZE) {
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	while(serial_tx_free() == 0) {
 		if(!interrupts_enabled) {
-			return 1;
+			return;
 		}		
 		/* else do nothing */
 	}
 	
-	/* Add the character to the buffer for transmission if there
-	 * is space to do so. We advance the insert_pos to the next
-	 * character position. If this is beyond the end of the buffer
-	 * we wrap around back to the beginning of the buffer 
-	 * NOTE: we disable interrupts before modifying the buffer. This
-	 * prevents the ISR from modifying the buffer at the same time.
-	 * We reenable them if they were enabled when we entered the
-	 * function.
+	/* Add the character to the buffer for transmission. Storing it
+	 * before moving out_head along means the ISR never sees the new
+	 * position before the character is there.
 	*/	
-	cli();
-	out_buffer[out_insert_pos++] = c;
-	bytes_in_out_buffer++;
-	if(out_insert_pos == OUTPUT_BUFFER_SIZE) {
-		/* Wrap around buffer pointer if necessary */
-		out_insert_pos = 0;
-	}
-	/* Reenable interrupts (UDR Empty interrupt may have been
-	 * disabled) - we ensure it is now enabled so that it will
+	uint8_t head = out_head;
+	out_buffer[head & OUTPUT_BUFFER_MASK] = c;
+	out_head = head + 1;
+	bytes_sent++;
+
+	/* Make sure the UDR Empty interrupt is enabled so that it will
 	 * fire and deal with the next character in the buffer. */
 	UCSR0B |= (1 << UDRIE0);
-	if(interrupts_enabled) {
-		sei();
-	}
-	return 0;
 }
 
 int uart_get_char(FILE* stream) {
 	/* Wait until we've received a character */
-	while(bytes_in_input_buffer == 0) {
+	while(input_head == input_tail) {
 		/* do nothing */
 	}
 	
 	/*
-	 * Turn interrupts off and remove a character from the input
-	 * buffer. We reenable interrupts if they were on.
-	 * The pending character is the one which is byte_in_input_buffer
-	 * characters before the insert position (taking into account
-	 * that we may need to wrap around).
+	 * Take the character and then move input_tail past it, which
+	 * hands its place back to the receive interrupt handler.
 	 */
-	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
-	cli();
-	char c;
-	if(input_insert_pos - bytes_in_input_buffer < 0) {
-		/* Need to wrap around */
-		c = input_buffer[input_insert_pos - bytes_in_input_buffer
-				+ INPUT_BUFFER_SIZE];
-	} else {
-		c = input_buffer[input_insert_pos - bytes_in_input_buffer];
+	uint8_t tail = input_tail;
+	char c = input_buffer[tail & INPUT_BUFFER_MASK];
+	input_tail = tail + 1;
+#if SERIAL_XON_XOFF
+	if(rx_stopped && (uint8_t)(input_head - input_tail) <= XON_LEVEL) {
+		/* let the transmit handler send XON */
+		UCSR0B |= (1 << UDRIE0);
 	}
-	
-	/* Decrement our count of bytes in the input buffer */
-	bytes_in_input_buffer--;
-	if(interrupts_enabled) {
-		sei();
-	}	
+#endif
 	return c;
 }
 
+/*
+ * Write a character to the UART, clearing the Transmit Complete flag
+ * (by writing a 1 to it) so that it shows when this character has gone.
+ * The error flags in the register have to be written as 0, the double
+ * speed bit is kept.
+ */
+static inline void transmit(char c) {
+	UCSR0A = (UCSR0A & (1 << U2X0)) | (1 << TXC0);
+	UDR0 = c;
+	transmitted = 1;
+}
+
 /*
  * Define the interrupt handler for UART Data Register Empty (i.e. 
  * another character can be taken from our buffer and written out)
  */
 ISR(USART_UDRE_vect) 
 {
-	/* Check if we have data in our buffer */
-	if(bytes_in_out_buffer > 0) {
-		/* Yes we do - remove the pending byte and output it
-		 * via the UART. The pending byte (character) is the
-		 * one which is "bytes_in_buffer" characters before the 
-		 * insert_pos (taking into account that we may 
-		 * need to wrap around to the end of the buffer).
-		 */
-		char c;
-		if(out_insert_pos - bytes_in_out_buffer < 0) {
-			/* Need to wrap around */
-			c = out_buffer[out_insert_pos - bytes_in_out_buffer
-				+ OUTPUT_BUFFER_SIZE];
-		} else {
-			c = out_buffer[out_insert_pos - bytes_in_out_buffer];
-		}
-		/* Decrement our count of the number of bytes in the 
-		 * buffer 
+#if SERIAL_XON_XOFF
+	/* Flow control characters go before anything else (except in
+	 * binary mode, where they would be taken as data)
+	 */
+	uint8_t waiting = input_head - input_tail;
+	if(binary_mode) {
+		/* no flow control */
+	} else if(!rx_stopped && waiting >= XOFF_LEVEL) {
+		transmit(XOFF);
+		rx_stopped = 1;
+		return;
+	} else if(rx_stopped && waiting <= XON_LEVEL) {
+		transmit(XON);
+		rx_stopped = 0;
+		return;
+	}
+#endif
+	/* Echoed characters go first, then our buffer */
+	uint8_t tail = echo_tail;
+	if(tail != echo_head) {
+		transmit(echo_buffer[tail & ECHO_BUFFER_MASK]);
+		echo_tail = tail + 1;
+		return;
+	}
+	tail = out_tail;
+	if(tail != out_head) {
+		/* Yes we do - output the pending byte via the UART and
+		 * then hand its place back to the main program.
 		 */
-		bytes_in_out_buffer--;
-		
-		/* Output the character via the UART */
-		UDR0 = c;
+		transmit(out_buffer[tail & OUTPUT_BUFFER_MASK]);
+		out_tail = tail + 1;
 	} else {
 		/* No data in the buffer. We disable the UART Data
 		 * Register Empty interrupt because otherwise it 
@@ -261,43 +482,55 @@ ISR(USART_UDRE_vect)
 
 ISR(USART_RX_vect) 
 {
-	/* Read the character - we ignore the possibility of overrun. */
+	/* Read the character, counting any lost because we were too
+	 * slow to read the one before (the flag has to be read first).
+	 */
 	char c;
+	if(UCSR0A & (1 << DOR0)) {
+		rx_stats.overruns++;
+	}
 	c = UDR0;
 		
-	if(do_echo && bytes_in_out_buffer < OUTPUT_BUFFER_SIZE) {
-		/* If echoing is enabled and there is output buffer
+	if(do_echo && !binary_mode
+			&& (uint8_t)(echo_head - echo_tail) < ECHO_BUFFER_SIZE) {
+		/* If echoing is enabled and there is echo buffer
 		 * space, echo the received character back to the UART.
-		 * (If there is no output buffer space, characters
-		 * will be lost.)
+		 * (If there is no space, characters will not be echoed.)
 		 */
-		uart_put_char(c, 0);
+		echo_buffer[echo_head & ECHO_BUFFER_MASK] = c;
+		echo_head++;
+		bytes_echoed++;
+		UCSR0B |= (1 << UDRIE0);
 	}
 	
 	/* 
-	 * Check if we have space in our buffer. If not, set the overrun
-	 * flag and throw away the character. (We never clear the 
-	 * overrun flag - it's up to the programmer to check/clear
-	 * this flag if desired.)
+	 * Check if we have space in our buffer. If not, count it as
+	 * dropped and throw away the character.
 	 */
-	if(bytes_in_input_buffer >= INPUT_BUFFER_SIZE) {
-		input_overrun = 1;
+	uint8_t head = input_head;
+	uint8_t waiting = head - input_tail;
+	if(waiting >= INPUT_BUFFER_SIZE) {
+		rx_stats.dropped++;
 	} else {
 		/* If the character is a carriage return, turn it into a
-		 * linefeed 
+		 * linefeed (unless it is binary data)
 		*/
-		if (c == '\r') {
+		if (c == '\r' && !binary_mode) {
 			c = '\n';
 		}
 		
 		/* 
 		 * There is room in the input buffer 
 		 */
-		input_buffer[input_insert_pos++] = c;
-		bytes_in_input_buffer++;
-		if(input_insert_pos == INPUT_BUFFER_SIZE) {
-			/* Wrap around buffer pointer if necessary */
-			input_insert_pos = 0;
-		}
+		input_buffer[head & INPUT_BUFFER_MASK] = c;
+		input_sequence[head & INPUT_BUFFER_MASK] = idle_next_sequence();
+		input_head = head + 1;
+		idle_post(IDLE_SERIAL);
+	}
+#if SERIAL_XON_XOFF
+	if(!rx_stopped && waiting + 1 >= XOFF_LEVEL) {
+		/* let the transmit handler send XOFF */
+		UCSR0B |= (1 << UDRIE0);
 	}
+#endif
 }
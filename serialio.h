@@ -17,6 +17,7 @@
 #define SERIALIO_H_
 
 #include <stdint.h>
+#include <avr/pgmspace.h>
 
 /* Initialise serial IO using the UART. baudrate specifies the desired
  * baud rate (e.g. 19200) and echo determines whether incoming characters
@@ -25,12 +26,106 @@
  */
 void init_serial_stdio(long baudrate, int8_t echo);
 
+/* Set SERIAL_XON_XOFF to 1 to have the board send XOFF to the computer
+ * when the input buffer is nearly full and XON when it has room again,
+ * so that input sent as fast as the baud rate allows isn't lost. (The
+ * terminal program must have XON/XOFF flow control turned on.)
+ */
+#ifndef SERIAL_XON_XOFF
+#define SERIAL_XON_XOFF 0
+#endif
+
+/* Counts of input characters lost since init_serial_stdio() */
+typedef struct {
+	uint16_t overruns;	/* arrived before the one before had been taken */
+	uint16_t dropped;	/* arrived when the input buffer was full */
+} serial_rx_stats_t;
+
+/* The clock the UART runs from, and the value of UBRR0 for a baud rate
+ * in double speed (U2X) mode, rounded to the nearest whole number. The
+ * rate which that gives is SERIAL_CLOCK / 8 / (UBRR + 1).
+ */
+#define SERIAL_CLOCK 16000000UL
+#define SERIAL_UBRR(baudrate) (((SERIAL_CLOCK / 4 / (baudrate)) + 1) / 2 - 1)
+
+/* Change the baud rate, once everything printed so far has been sent.
+ * The rate is not checked - see baud.h for which rates work.
+ */
+void serial_set_baud(uint32_t baudrate);
+
+/* Return the baud rate in use */
+uint32_t serial_get_baud(void);
+
+/* Wait until everything printed so far has been sent */
+void serial_flush(void);
+
 /* Test if input is available from the serial port. Return 0 if not,
  * non-zero otherwise. If there is input available then it can be read
  * with a suitable standard IO library function, e.g. fgetc().
  */
 int8_t serial_input_available(void);
 
+/* If a character is waiting to be read, set *sequence to the stamp it was
+ * given when it arrived (see idle_next_sequence()) and return 1,
+ * otherwise return 0.
+ */
+uint8_t serial_input_sequence(uint8_t *sequence);
+
+/* Return the number of bytes sent to the serial port since
+ * init_serial_stdio() was called (including those still waiting in the
+ * output buffer). Each \n counts twice as it is sent as \r\n.
+ */
+uint32_t serial_bytes_sent(void);
+
+/* Put a byte straight into the output buffer, without going through
+ * stdio (no \r is added to \n). This waits for room in the buffer as
+ * printing does. It can be mixed freely with stdio output, which is
+ * not buffered.
+ */
+void serial_put_byte(char c);
+
+/* Return the number of bytes which can be printed without waiting for
+ * the output buffer to make room for them.
+ */
+uint8_t serial_tx_free(void);
+
+/* Put 'length' bytes in the output buffer, waiting for room as printing
+ * does. serial_write_P() takes them from program memory. This is cheaper
+ * than printing them one at a time.
+ */
+void serial_write(const void *data, uint16_t length);
+void serial_write_P(PGM_P data, uint16_t length);
+
+/* Output priorities. Output which must get through (the board) may use
+ * the whole output buffer, output which can be dropped or sent later
+ * (the cursor blinking, status text) leaves SERIAL_TX_RESERVE bytes of
+ * it for the board.
+ */
+#define SERIAL_PRIORITY_HIGH	0
+#define SERIAL_PRIORITY_LOW		1
+#define SERIAL_TX_RESERVE		64
+
+/* Return the number of bytes output of the given priority can send now
+ * without waiting for the output buffer, so that a whole escape sequence
+ * or line can be sent or left for later rather than waited for.
+ */
+uint8_t serial_tx_headroom(uint8_t priority);
+
+/* Put as much of 'data' in the output buffer as there is room for,
+ * without waiting, and return how many bytes were taken.
+ */
+uint8_t serial_write_nonblocking(const char *data, uint8_t length);
+
+/* Turn binary mode on (non-zero) or off. In binary mode bytes are
+ * received exactly as sent: carriage returns are not turned into
+ * linefeeds, nothing is echoed and no XON/XOFF is sent. (Output written
+ * with serial_write() is always sent as it is.)
+ */
+void serial_set_binary(uint8_t binary);
+
+/* Copy the counts of lost input characters into 'stats' */
+void serial_get_rx_stats(serial_rx_stats_t *stats);
+
 /* Discard any input waiting to be read from the serial port. (Characters may
  * have been typed when we didn't want them - clear them.
  */
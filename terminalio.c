@@ -2,73 +2,378 @@
  * terminalio.c
  *
  * Author: Peter Sutton
+ *
+ * The module remembers where the terminal's cursor is and which display
+ * attributes (colours etc.) are in effect, so that escape sequences
+ * which would change nothing are not sent:
+ *  - a cursor move to where the cursor already is sends nothing, and
+ *    other moves use whichever of the absolute or relative forms is
+ *    shortest
+ *  - attribute changes are only recorded when asked for and are sent
+ *    when something is next drawn, so a reset followed by the attribute
+ *    that was already in effect sends nothing at all
+ * Text must be printed with the term_print functions for this to work.
+ * If anything else is printed (noticed from the count of bytes sent by
+ * the serial port) the cursor position is forgotten until the next
+ * absolute move.
  */
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdarg.h>
 
 #include <avr/pgmspace.h>
 
 #include "terminalio.h"
+#include "serialio.h"
+
+// where the cursor is, 0 if not known
+static uint8_t cursor_x, cursor_y;
+
+// attributes as the terminal has them and as they have been asked for:
+// the foreground and background colour (0 for the default) and a bit
+// for each of the other attributes (1 << TERM_BRIGHT etc.)
+typedef struct {
+	uint8_t fg;
+	uint8_t bg;
+	uint16_t modes;
+} attributes_t;
+
+static attributes_t actual, wanted;
+// set until the terminal's attributes are known
+static uint8_t actual_unknown = 1;
+
+// serial_bytes_sent() when this module last finished sending
+static uint32_t bytes_tracked;
+
+// check nothing has been printed behind our back
+static void check_untracked_output(void) {
+	if (serial_bytes_sent() != bytes_tracked) {
+		cursor_x = 0;
+		cursor_y = 0;
+	}
+}
+
+static void end_of_output(void) {
+	bytes_tracked = serial_bytes_sent();
+}
+
+// The escape sequences are written straight into the serial output
+// buffer by the functions below, rather than formatted with printf, as
+// they are only fixed text and small numbers.
+
+// send the start of a control sequence, ESC [
+static void put_csi(void) {
+	serial_put_byte('\x1b');
+	serial_put_byte('[');
+}
+
+// send a number (without leading zeros), working out the digits by
+// subtraction since the AVR has no divide instruction
+static void put_number(uint8_t n) {
+	uint8_t hundreds = 0;
+	uint8_t tens = 0;
+	while (n >= 100) {
+		n -= 100;
+		hundreds++;
+	}
+	while (n >= 10) {
+		n -= 10;
+		tens++;
+	}
+	if (hundreds) {
+		serial_put_byte('0' + hundreds);
+	}
+	if (hundreds || tens) {
+		serial_put_byte('0' + tens);
+	}
+	serial_put_byte('0' + n);
+}
+
+// send a string from program memory, returns its length
+static uint8_t put_P(const char *text) {
+	uint8_t length = strlen_P(text);
+	serial_write_P(text, length);
+	return length;
+}
+
+// send the attributes that have been asked for, if they are not the ones
+// in effect already
+static void apply_attributes(void) {
+	if (!actual_unknown && actual.fg == wanted.fg && actual.bg == wanted.bg
+			&& actual.modes == wanted.modes) {
+		return;
+	}
+	// an attribute can only be turned off by resetting them all
+	uint8_t reset = actual_unknown || (actual.fg && !wanted.fg)
+			|| (actual.bg && !wanted.bg) || (actual.modes & ~wanted.modes);
+	uint16_t modes = reset ? wanted.modes : wanted.modes & ~actual.modes;
+	uint8_t first = 1;
+
+	put_csi();
+	if (reset) {
+		serial_put_byte('0');
+		first = 0;
+	}
+	for (uint8_t mode = TERM_BRIGHT; mode <= TERM_HIDDEN; mode++) {
+		if (modes & (1 << mode)) {
+			if (!first) {
+				serial_put_byte(';');
+			}
+			serial_put_byte('0' + mode);
+			first = 0;
+		}
+	}
+	if (wanted.fg && (reset || wanted.fg != actual.fg)) {
+		if (!first) {
+			serial_put_byte(';');
+		}
+		put_number(wanted.fg);
+		first = 0;
+	}
+	if (wanted.bg && (reset || wanted.bg != actual.bg)) {
+		if (!first) {
+			serial_put_byte(';');
+		}
+		put_number(wanted.bg);
+	}
+	serial_put_byte('m');
+	actual = wanted;
+	actual_unknown = 0;
+}
+
+// the number of characters needed to print a number
+static uint8_t digits(uint8_t n) {
+	return (n >= 100) ? 3 : (n >= 10) ? 2 : 1;
+}
+
+// length of a relative move of n places (ESC [ n letter, n left out if 1)
+static uint8_t relative_length(uint8_t n) {
+	return n == 0 ? 0 : (n == 1) ? 3 : 3 + digits(n);
+}
+
+static void relative_move(uint8_t n, char direction) {
+	if (n == 0) {
+		return;
+	}
+	put_csi();
+	if (n > 1) {
+		put_number(n);
+	}
+	serial_put_byte(direction);
+}
 
 void move_terminal_cursor(int x, int y) {
-    printf_P(PSTR("\x1b[%d;%dH"), y, x);
+	check_untracked_output();
+	if (x == cursor_x && y == cursor_y) {
+		return;
+	}
+	if (cursor_x && cursor_y) {
+		uint8_t dx = (x > cursor_x) ? x - cursor_x : cursor_x - x;
+		uint8_t dy = (y > cursor_y) ? y - cursor_y : cursor_y - y;
+		uint8_t absolute = 4 + digits(y) + digits(x);
+		if (relative_length(dx) + relative_length(dy) < absolute) {
+			relative_move(dy, (y > cursor_y) ? 'B' : 'A');
+			relative_move(dx, (x > cursor_x) ? 'C' : 'D');
+			cursor_x = x;
+			cursor_y = y;
+			end_of_output();
+			return;
+		}
+	}
+	put_csi();
+	put_number(y);
+	serial_put_byte(';');
+	put_number(x);
+	serial_put_byte('H');
+	cursor_x = x;
+	cursor_y = y;
+	end_of_output();
 }
 
 void normal_display_mode(void) {
-	printf_P(PSTR("\x1b[0m"));
+	wanted.fg = 0;
+	wanted.bg = 0;
+	wanted.modes = 0;
 }
 
 void reverse_video(void) {
-	printf_P(PSTR("\x1b[7m"));
+	wanted.modes |= 1 << TERM_REVERSE;
 }
 
 void clear_terminal(void) {
-	printf_P(PSTR("\x1b[2J"));
+	// the screen is cleared to the background colour in effect
+	check_untracked_output();
+	apply_attributes();
+	put_P(PSTR("\x1b[2J"));
+	end_of_output();
 }
 
 void clear_to_end_of_line(void) {
-	printf_P(PSTR("\x1b[K"));
+	check_untracked_output();
+	apply_attributes();
+	put_P(PSTR("\x1b[K"));
+	end_of_output();
 }
 
 void set_display_attribute(DisplayParameter parameter) {
-	printf_P(PSTR("\x1b[%dm"), parameter);
+	if (parameter == TERM_RESET) {
+		normal_display_mode();
+	} else if (parameter >= BG_BLACK) {
+		wanted.bg = parameter;
+	} else if (parameter >= FG_BLACK) {
+		wanted.fg = parameter;
+	} else {
+		wanted.modes |= 1 << parameter;
+	}
 }
 
 void hide_cursor() {
-	printf_P(PSTR("\x1b[?25l"));
+	check_untracked_output();
+	put_P(PSTR("\x1b[?25l"));
+	end_of_output();
 }
 
 void show_cursor() {
-	printf_P(PSTR("\x1b[?25h"));
+	check_untracked_output();
+	put_P(PSTR("\x1b[?25h"));
+	end_of_output();
 }
 
 void enable_scrolling_for_whole_display(void) {
-	printf_P(PSTR("\x1b[r"));
+	// this also moves the cursor to the top left
+	put_P(PSTR("\x1b[r"));
+	cursor_x = 1;
+	cursor_y = 1;
+	end_of_output();
 }
 
 void set_scroll_region(int8_t y1, int8_t y2) {
-	printf_P(PSTR("\x1b[%d;%dr"), y1, y2);
+	put_csi();
+	put_number(y1);
+	serial_put_byte(';');
+	put_number(y2);
+	serial_put_byte('r');
+	cursor_x = 1;
+	cursor_y = 1;
+	end_of_output();
 }
 
 void scroll_down(void) {
-	printf_P(PSTR("\x1bM"));	// ESC-M
+	put_P(PSTR("\x1bM"));	// ESC-M
+	// the cursor may or may not have moved
+	cursor_x = 0;
+	cursor_y = 0;
+	end_of_output();
 }
 
 void scroll_up(void) {
-	printf_P(PSTR("\x1b\x44"));	// ESC-D
+	put_P(PSTR("\x1b\x44"));	// ESC-D
+	cursor_x = 0;
+	cursor_y = 0;
+	end_of_output();
+}
+
+void term_print_P(const char *text) {
+	check_untracked_output();
+	apply_attributes();
+	uint8_t length = put_P(text);
+	if (cursor_x) {
+		cursor_x += length;
+	}
+	end_of_output();
+}
+
+uint8_t term_status_printf_P(uint8_t x, uint8_t y, const char *format, ...) {
+	char text[TERM_STATUS_LENGTH + 1];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf_P(text, sizeof(text), format, args);
+	va_end(args);
+	int room = (x < TERM_STATUS_LENGTH) ? TERM_STATUS_LENGTH - x : 0;
+	if (length > room) {
+		length = room;
+	}
+
+	// the most the cursor move (ESC [ yyy ; xxx H), the attributes being
+	// reset (ESC [ 0 m) and the clear to the end of the line (ESC [ K)
+	// can take
+	if (serial_tx_headroom(SERIAL_PRIORITY_LOW) < 10 + 4 + 3 + length) {
+		return 0;
+	}
+	normal_display_mode();
+	move_terminal_cursor(x, y);
+	clear_to_end_of_line();
+	serial_write_nonblocking(text, length);
+	cursor_x += length;
+	end_of_output();
+	return 1;
+}
+
+void term_field_printf_P(uint8_t x, uint8_t y, uint8_t width, const char *format, ...) {
+	char text[TERM_STATUS_LENGTH + 1];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf_P(text, sizeof(text), format, args);
+	va_end(args);
+	uint8_t room = (x < TERM_STATUS_LENGTH) ? TERM_STATUS_LENGTH - x : 0;
+	if (width > room) {
+		width = room;
+	}
+	if (length < 0) {
+		length = 0;
+	} else if (length > width) {
+		length = width;
+	}
+	while (length < width) {
+		text[length++] = ' ';
+	}
+
+	normal_display_mode();
+	move_terminal_cursor(x, y);
+	serial_write(text, width);
+	cursor_x += width;
+	end_of_output();
+}
+
+void term_print_number(uint8_t value, uint8_t width) {
+	check_untracked_output();
+	apply_attributes();
+	uint8_t length = digits(value);
+	for (; length < width; length++) {
+		serial_put_byte(' ');
+	}
+	put_number(value);
+	if (cursor_x) {
+		cursor_x += length;
+	}
+	end_of_output();
+}
+
+void term_printf_P(const char *format, ...) {
+	check_untracked_output();
+	apply_attributes();
+	uint32_t before = serial_bytes_sent();
+	va_list args;
+	va_start(args, format);
+	vfprintf_P(stdout, format, args);
+	va_end(args);
+	if (cursor_x) {
+		cursor_x += serial_bytes_sent() - before;
+	}
+	end_of_output();
 }
 
 void draw_horizontal_line(int8_t y, int8_t start_x, int8_t end_x) {
 	int8_t i;
 	move_terminal_cursor(start_x, y);
 	reverse_video();
+	apply_attributes();
 	for(i=start_x; i <= end_x; i++) {
-		printf(" ");	/* No need to use printf_P - printing 
-						 * a single character gets optimised
-						 * to a putchar call 
-						 */
+		serial_put_byte(' ');
 	}
+	cursor_x = end_x + 1;
+	end_of_output();
 	normal_display_mode();
 }
 
@@ -76,11 +381,15 @@ void draw_vertical_line(int8_t x, int8_t start_y, int8_t end_y) {
 	int8_t i;
 	move_terminal_cursor(x, start_y);
 	reverse_video();
+	apply_attributes();
 	for(i=start_y; i < end_y; i++) {
-		printf(" ");
+		serial_put_byte(' ');
 		/* Move down one and back to the left one */
-		printf_P(PSTR("\x1b[B\x1b[D"));
+		put_P(PSTR("\x1b[B\x1b[D"));
 	}
-	printf(" ");
+	serial_put_byte(' ');
+	cursor_x = x + 1;
+	cursor_y = end_y;
+	end_of_output();
 	normal_display_mode();
 }
@@ -5,6 +5,14 @@
  *
  * Functions for interacting with the terminal. These should be used
  * to encapsulate all sending of escape sequences.
+ *
+ * The module keeps track of the cursor position and display attributes
+ * so it can leave out escape sequences which would change nothing.
+ * Attribute changes (set_display_attribute(), normal_display_mode(),
+ * reverse_video()) only take effect when something is next drawn, so
+ * text should be printed with term_print_P()/term_printf_P() rather than
+ * printf. (Text printed with printf still appears, but the cursor
+ * position is then forgotten and the attributes may not be up to date.)
  */
 
 #ifndef TERMINAL_IO_H_
@@ -63,6 +71,34 @@ void set_display_attribute(DisplayParameter parameter);
 void hide_cursor(void);
 void show_cursor(void);
 
+// Print text at the cursor with the attributes that have been set. The
+// text is in program memory and must not contain newlines or escape
+// sequences.
+void term_print_P(const char *text);
+void term_printf_P(const char *format, ...);
+
+// Show a line of status text at (x, y), clearing the rest of the line,
+// if the serial port has room for all of it now (at low priority, see
+// serial_tx_headroom()). Otherwise nothing is sent, so that showing it
+// never has to wait. Returns 1 if it was shown, 0 if it was dropped. The
+// text is cut short at column TERM_STATUS_LENGTH, so that it never wraps
+// onto the next line (which would leave the cursor somewhere other than
+// where it is thought to be).
+#define TERM_COLUMNS 80
+#define TERM_STATUS_LENGTH (TERM_COLUMNS - 1)
+uint8_t term_status_printf_P(uint8_t x, uint8_t y, const char *format, ...);
+
+// Show text at (x, y) in a field 'width' characters wide, cut short or
+// padded out with spaces so that it covers whatever the field showed
+// before and leaves the rest of the line alone. The field is cut short
+// at column TERM_STATUS_LENGTH too. Unlike term_status_printf_P() this
+// waits for room in the serial port.
+void term_field_printf_P(uint8_t x, uint8_t y, uint8_t width, const char *format, ...);
+
+// Print a number right aligned in a field of 'width' characters (wider
+// if the number needs it), without going through printf.
+void term_print_number(uint8_t value, uint8_t width);
+
 // Enable scrolling for either the full screen or a particular region (rows)
 // For set_scroll_region y1 < y2 and the region includes rows y1 and y2.
 void enable_scrolling_for_whole_display(void);
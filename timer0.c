@@ -10,9 +10,11 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 
 #include "timer0.h"
-#include "scoring.h"
+#include "timer1.h"
+#include "buttons.h"
 
 
 /* Our internal clock tick count - incremented every 
@@ -23,10 +25,33 @@ static volatile uint32_t clockTicks;
 uint8_t pause_state = 0;
 
 // Seven segment display - segment values for digits 0 to 9
-uint8_t seven_seg[10] = {63, 6, 91, 79, 102, 109, 125, 7, 127, 111};
+static const uint8_t seven_seg[10] PROGMEM = {63, 6, 91, 79, 102, 109, 125, 7, 127, 111};
+
+// The pins the display uses. The right digit is selected with port B pin
+// 3 and the left with port C pin 3. The segments are port D pins 2 to 7
+// (the lower 6 bits of the pattern) and port B pins 4 and 5 (the upper 2).
+#define SEVEN_SEG_PORTB_PINS 0x38
+#define SEVEN_SEG_PORTC_PINS (1 << PORTC3)
+#define SEVEN_SEG_PORTD_PINS 0xFC
+
+// What to write to the display's pins of ports B, C and D for each digit
+// (0 = right, 1 = left), worked out by set_seven_seg_number() so that the
+// interrupt handler only has to copy them
+static volatile uint8_t digit_portb[2];
+static volatile uint8_t digit_portc[2];
+static volatile uint8_t digit_portd[2];
 
 uint8_t digit = 0; /* 0 = right, 1 = left */
 
+/* Milliseconds until the buttons are next sampled */
+static uint8_t button_countdown = BUTTON_SAMPLE_MS;
+
+#if ISR_PROFILE
+/* Cycles spent in the interrupt handler, and in sampling the buttons */
+static volatile isr_profile_t isr_profile;
+static volatile isr_profile_t button_profile;
+#endif
+
 /* Set up timer 0 to generate an interrupt every 1ms. 
  * We will divide the clock by 64 and count up to 249.
  * We will therefore get an interrupt every 64 x 250
@@ -92,17 +117,42 @@ uint32_t get_current_time(void) {
 	return returnValue;
 }
 
-void display_digit(uint8_t number, uint8_t digit)
-{
-	// Right digit select is on port B, left is port C.
-	PORTB |= (!digit << PORTB3);
-	PORTC |= (digit << PORTC3);
+void set_seven_seg_number(uint8_t number) {
+	// Split the number into its digits (the AVR has no divide
+	// instruction, this is done once per change rather than every tick)
+	uint8_t tens = 0;
+	while(number >= 10) {
+		number -= 10;
+		tens++;
+	}
+	uint8_t right = pgm_read_byte(&seven_seg[number]);
+	uint8_t left = pgm_read_byte(&seven_seg[tens % 10]);
 	
-	// We assume digit is in range 0 to 9
-	// Note |= for PORTB since we do not want to overwrite the CC pin setting.
-	PORTB |= ((seven_seg[number] & 0xC0) >> 6) << 4; // output upper 2 bits of SSD to Port B bits 4 and 5
-	PORTD |= (seven_seg[number] & 0x3F) << 2; // output lower 6 bits of SSD to Port D.
+	// Interrupts are turned off so the handler never shows half of it
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	digit_portb[0] = (1 << PORTB3) | ((right & 0xC0) >> 2);
+	digit_portc[0] = 0;
+	digit_portd[0] = (right & 0x3F) << 2;
+	digit_portb[1] = (left & 0xC0) >> 2;
+	digit_portc[1] = (1 << PORTC3);
+	digit_portd[1] = (left & 0x3F) << 2;
+	if(interruptsOn) {
+		sei();
+	}
+}
+
+#if ISR_PROFILE
+void get_timer0_profile(isr_profile_t *whole, isr_profile_t *buttons) {
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	*whole = isr_profile;
+	*buttons = button_profile;
+	if(interruptsOn) {
+		sei();
+	}
 }
+#endif
 
 void pause_game(void) {
 	if (pause_state == 0) {
@@ -113,25 +163,35 @@ void pause_game(void) {
 }
 
 ISR(TIMER0_COMPA_vect) {
+	ISR_PROFILE_START();
+	
 	/* Increment our clock tick count */
 	if (pause_state == 0) {
 		clockTicks++;
-	} else {
-		clockTicks = clockTicks;
 	}
 	
+	/* Show the next digit. The display's pins are set to the values
+	 * worked out for it, which also turns off the segments and the
+	 * select pin of the digit shown before.
+	 */
+	uint8_t d = digit;
+	PORTB = (PORTB & ~SEVEN_SEG_PORTB_PINS) | digit_portb[d];
+	PORTC = (PORTC & ~SEVEN_SEG_PORTC_PINS) | digit_portc[d];
+	PORTD = (PORTD & ~SEVEN_SEG_PORTD_PINS) | digit_portd[d];
+	/* Change the digit flag for next time. if 0 becomes 1, if 1 becomes 0. */
+	digit = d ^ 1;
 	
-	uint8_t value;
-	
-	if(digit == 0) {
-		/* Extract the ones place from the timer counter 0 value */
-		/* HINT: Consider the modulus (%) operator. */
-		value = get_score() % 10;
-		} else {
-		/* Extract the tens place from the timer counter 0 */
-		value = (get_score() / 10) % 10;
+	/* Sample the buttons every BUTTON_SAMPLE_MS ticks */
+	if(--button_countdown == 0) {
+		button_countdown = BUTTON_SAMPLE_MS;
+#if ISR_PROFILE
+		uint16_t button_start = TCNT1;
+		buttons_sample(clockTicks);
+		isr_profile_record(&button_profile, TCNT1 - button_start);
+#else
+		buttons_sample(clockTicks);
+#endif
 	}
-	display_digit(value, digit);
-	/* Change the digit flag for next time. if 0 becomes 1, if 1 becomes 0. */
-	digit = 1 - digit;
+	
+	ISR_PROFILE_END(isr_profile);
 }
@@ -20,6 +20,8 @@
 
 #include <stdint.h>
 
+#include "timer1.h"
+
 /* Set up our timer to give us an interrupt every millisecond
  * and update our time reference.
  */
@@ -30,11 +32,17 @@ void init_timer0(void);
  */
 uint32_t get_current_time(void);
 
-//  Display digit function. Arguments are the digit
-// number (0 to 9) and the digit to display it on (0 = right, 1 = left). 
-void display_digit(uint8_t number, uint8_t digit);
+// show 'number' (0 to 99) on the seven segment display. The interrupt
+// handler shows each digit in turn, with its pins worked out here.
+void set_seven_seg_number(uint8_t number);
 
 // change the pause state
 void pause_game(void);
 
+#if ISR_PROFILE
+// copy the cycles spent in the interrupt handler as a whole, and in
+// sampling the buttons, into 'whole' and 'buttons' (see timer1.h)
+void get_timer0_profile(isr_profile_t *whole, isr_profile_t *buttons);
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*
+ * timer1.c
+ *
+ * We set up timer 1 to count every clock cycle. The counter overflows
+ * every 65536 cycles (4.096ms at 16MHz), the interrupt handler counts
+ * the overflows to give the upper 16 bits of the cycle count.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "timer1.h"
+
+/* The number of times timer 1 has overflowed - the upper 16 bits of
+ * the cycle count. */
+static volatile uint16_t overflows;
+
+void init_timer1(void) {
+	overflows = 0;
+	
+	/* Normal mode (count up to 0xFFFF and wrap), no prescaling. This
+	 * starts the timer running.
+	 */
+	TCCR1A = 0;
+	TCNT1 = 0;
+	TCCR1B = (1<<CS10);
+	
+	/* Interrupt on overflow. Make sure the overflow flag is clear by
+	 * writing a 1 to it.
+	 */
+	TIFR1 = (1<<TOV1);
+	TIMSK1 |= (1<<TOIE1);
+}
+
+uint32_t get_cycle_count(void) {
+	uint16_t low, high;
+	
+	/* Disable interrupts so that the two halves are read together. 
+	 * Interrupts are re-enabled if they were enabled at the start.
+	 */
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	low = TCNT1;
+	high = overflows;
+	/* The counter may have wrapped after interrupts were disabled, in
+	 * which case the overflow has not been counted yet. (A small value
+	 * of low means the wrap happened before it was read.)
+	 */
+	if ((TIFR1 & (1<<TOV1)) && low < 0x8000) {
+		high++;
+	}
+	if(interruptsOn) {
+		sei();
+	}
+	return ((uint32_t)high << 16) | low;
+}
+
+ISR(TIMER1_OVF_vect) {
+	overflows++;
+}
@@ -0,0 +1,58 @@
+/*
+ * timer1.h
+ *
+ * We set up timer 1 to count CPU clock cycles. It runs freely at the
+ * full clock rate and an overflow interrupt extends the 16 bit counter
+ * to 32 bits, so times of up to about 268 seconds can be measured with
+ * single cycle resolution. This is used to measure how long pieces of
+ * code take to run.
+ */
+
+#ifndef TIMER1_H_
+#define TIMER1_H_
+
+#include <stdint.h>
+
+/* Start timer 1 counting clock cycles.
+ */
+void init_timer1(void);
+
+/* Return the number of clock cycles since init_timer1() was called.
+ * Subtract two of these values to find how long something took.
+ */
+uint32_t get_cycle_count(void);
+
+/* Interrupt handler profiling. With ISR_PROFILE set to 1 a handler can
+ * time its body by putting ISR_PROFILE_START() at the top of it and
+ * ISR_PROFILE_END(profile) at the bottom, which reads the low 16 bits of
+ * the cycle counter at each end. (The registers the compiler saves and
+ * restores around the body, and the 4 cycles to enter the handler, are
+ * not counted.) The counts are only changed by the handler, so they
+ * should be copied with interrupts off.
+ */
+#ifndef ISR_PROFILE
+#define ISR_PROFILE 0
+#endif
+
+typedef struct {
+	uint32_t calls;
+	uint32_t total_cycles;
+	uint16_t max_cycles;
+} isr_profile_t;
+
+#if ISR_PROFILE
+static inline void isr_profile_record(volatile isr_profile_t *profile, uint16_t cycles) {
+	profile->calls++;
+	profile->total_cycles += cycles;
+	if (cycles > profile->max_cycles) {
+		profile->max_cycles = cycles;
+	}
+}
+#define ISR_PROFILE_START() uint16_t isr_profile_start = TCNT1
+#define ISR_PROFILE_END(profile) isr_profile_record(&(profile), TCNT1 - isr_profile_start)
+#else
+#define ISR_PROFILE_START()
+#define ISR_PROFILE_END(profile)
+#endif
+
+#endif
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+"""
+make_book.py
+
+Builds the opening book (book_data.c) from the opening lines listed in
+tools/openings.txt.
+
+Every line is checked for legality move by move (a line is cut short at
+its first illegal move). Lines are then put into a canonical orientation:
+of the 8 symmetries of the board, the ones which leave the starting
+position unchanged are tried and the one giving the smallest sequence of
+square numbers is kept, so lines which are reflections of each other are
+only stored once. The lines are merged into a trie which is written out
+in preorder, one byte per move:
+
+    bits 0-5  the square (x + 8 * y, y counted from the bottom as in game.c)
+    bit 6     BOOK_LAST_SIBLING, this is the last reply in its list
+    bit 7     BOOK_HAS_REPLIES, the node's replies follow straight after it
+
+Replies are ordered so that the one played most often comes first, this
+is the one the computer plays.
+
+Usage: python3 tools/make_book.py [openings.txt] [book_data.c]
+"""
+
+import os
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_INPUT = os.path.join(HERE, "openings.txt")
+DEFAULT_OUTPUT = os.path.join(HERE, "..", "book_data.c")
+
+# must match book.h
+BOOK_MAX_PLY = 16
+LAST_SIBLING = 0x40
+HAS_REPLIES = 0x80
+
+# the starting position, as in game.c (x, y)
+P1_START = {(3, 3), (4, 4)}
+P2_START = {(3, 4), (4, 3)}
+
+DIRECTIONS = [(dx, dy) for dx in (-1, 0, 1) for dy in (-1, 0, 1) if dx or dy]
+
+
+def square_of(name):
+    """Standard notation (row 1 at the top) to a game.c square number."""
+    x = ord(name[0]) - ord("a")
+    row = int(name[1])
+    if not (0 <= x < 8 and 1 <= row <= 8):
+        raise ValueError("bad square " + name)
+    return x + 8 * (8 - row)
+
+
+def name_of(sq):
+    return "%s%d" % ("abcdefgh"[sq % 8], 8 - sq // 8)
+
+
+def transform(sq, sym):
+    """Apply symmetry sym (0-7) to a square. Bit 0 mirrors x, bit 1
+    mirrors y and bit 2 then swaps x and y (as in book.c)."""
+    x, y = sq % 8, sq // 8
+    if sym & 1:
+        x = 7 - x
+    if sym & 2:
+        y = 7 - y
+    if sym & 4:
+        x, y = y, x
+    return x + 8 * y
+
+
+def start_symmetries():
+    """The symmetries which map the starting position onto itself."""
+    p1 = {x + 8 * y for x, y in P1_START}
+    p2 = {x + 8 * y for x, y in P2_START}
+    return [s for s in range(8)
+            if {transform(q, s) for q in p1} == p1
+            and {transform(q, s) for q in p2} == p2]
+
+
+class Board:
+    def __init__(self):
+        self.cells = {}
+        for x, y in P1_START:
+            self.cells[(x, y)] = 0
+        for x, y in P2_START:
+            self.cells[(x, y)] = 1
+        self.side = 0
+
+    def flips(self, x, y, side):
+        if (x, y) in self.cells:
+            return []
+        result = []
+        for dx, dy in DIRECTIONS:
+            run = []
+            cx, cy = x + dx, y + dy
+            while self.cells.get((cx, cy)) == 1 - side:
+                run.append((cx, cy))
+                cx, cy = cx + dx, cy + dy
+            if run and self.cells.get((cx, cy)) == side:
+                result.extend(run)
+        return result
+
+    def has_move(self, side):
+        return any(self.flips(x, y, side) for x in range(8) for y in range(8))
+
+    def play(self, sq):
+        x, y = sq % 8, sq // 8
+        flipped = self.flips(x, y, self.side)
+        if not flipped:
+            return False
+        for cell in flipped + [(x, y)]:
+            self.cells[cell] = self.side
+        self.side = 1 - self.side
+        return self.has_move(self.side)
+
+
+def parse_lines(path):
+    lines = []
+    for number, text in enumerate(open(path), 1):
+        text = text.split("#")[0].strip()
+        if not text:
+            continue
+        moves_text = text.split()[0]
+        moves = [square_of(moves_text[i:i + 2])
+                 for i in range(0, len(moves_text), 2)]
+        board = Board()
+        legal = []
+        for i, sq in enumerate(moves):
+            if not board.flips(sq % 8, sq // 8, board.side):
+                print("line %d: %s is illegal, line cut short"
+                      % (number, name_of(sq)), file=sys.stderr)
+                break
+            legal.append(sq)
+            if not board.play(sq) and i < len(moves) - 1:
+                # passes can not be stored in the book
+                print("line %d: pass after %s, line cut short"
+                      % (number, name_of(sq)), file=sys.stderr)
+                break
+        lines.append(legal[:BOOK_MAX_PLY])
+    return lines
+
+
+def canonical(line, symmetries):
+    return min([transform(sq, s) for sq in line] for s in symmetries)
+
+
+def build_trie(lines):
+    root = {}
+    counts = {}
+    order = {}
+    for line in lines:
+        node = root
+        prefix = ()
+        for sq in line:
+            prefix += (sq,)
+            counts[prefix] = counts.get(prefix, 0) + 1
+            order.setdefault(prefix, len(order))
+            node = node.setdefault(sq, {})
+    return root, counts, order
+
+
+def encode(node, prefix, counts, order, out):
+    replies = sorted(node, key=lambda sq: (-counts[prefix + (sq,)],
+                                           order[prefix + (sq,)]))
+    for i, sq in enumerate(replies):
+        byte = sq
+        if i == len(replies) - 1:
+            byte |= LAST_SIBLING
+        if node[sq]:
+            byte |= HAS_REPLIES
+        out.append(byte)
+        encode(node[sq], prefix + (sq,), counts, order, out)
+
+
+def main():
+    source = sys.argv[1] if len(sys.argv) > 1 else DEFAULT_INPUT
+    target = sys.argv[2] if len(sys.argv) > 2 else DEFAULT_OUTPUT
+
+    symmetries = start_symmetries()
+    lines = [canonical(line, symmetries) for line in parse_lines(source) if line]
+    trie, counts, order = build_trie(lines)
+    data = []
+    encode(trie, (), counts, order, data)
+    longest = max(len(line) for line in lines)
+
+    with open(target, "w") as out:
+        out.write("/*\n * book_data.c\n *\n")
+        out.write(" * Generated by tools/make_book.py from tools/openings.txt,"
+                  " do not edit.\n *\n")
+        out.write(" * %d lines, %d positions, up to %d plies deep,"
+                  " %d bytes of flash.\n */\n\n" % (len(lines), len(data),
+                                                     longest, len(data)))
+        out.write("#include <avr/pgmspace.h>\n\n#include \"book.h\"\n\n")
+        out.write("const uint8_t opening_book[] PROGMEM = {\n")
+        for i in range(0, len(data), 12):
+            out.write("\t" + " ".join("0x%02X," % b for b in data[i:i + 12]) + "\n")
+        out.write("};\n\nconst uint16_t opening_book_size = sizeof(opening_book);\n")
+
+    print("%d lines, %d positions, %d plies deep, %d bytes of flash"
+          % (len(lines), len(data), longest, len(data)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""
+remote.py
+
+Plays games against the board's computer player through its remote
+control mode (see remote.h), checking every reply: this side plays random
+legal moves, the board searches for its own. It can talk to the board over
+a serial port (needs pyserial) or run the host build and talk to it
+through a pipe.
+
+Usage:
+    python3 tools/remote.py PORT [GAMES] [TIME_MS]
+    python3 tools/remote.py --exec host/build/reversi [GAMES] [TIME_MS]
+"""
+
+import binascii
+import random
+import struct
+import subprocess
+import sys
+import time
+
+# must match remote.h
+ENQ = 0x05
+SOF = 0xA5
+REPLY = 0x80
+ERROR = 0xFF
+HELLO = 0x00
+NEW_GAME = 0x01
+PLACE = 0x02
+GET_MOVES = 0x03
+GET_POSITION = 0x04
+GET_STATS = 0x05
+COMPUTER_MOVE = 0x06
+EXIT = 0x07
+
+ERRORS = {1: "bad CRC", 2: "wrong length", 3: "no such command",
+          4: "illegal move", 5: "game over"}
+
+
+class RemoteError(Exception):
+    pass
+
+
+class PipeLink:
+    """The host build, run with its stdin and stdout as the serial port."""
+
+    def __init__(self, program):
+        self.process = subprocess.Popen([program], stdin=subprocess.PIPE,
+                                        stdout=subprocess.PIPE, bufsize=0)
+
+    def write(self, data):
+        self.process.stdin.write(data)
+
+    def read(self, count):
+        data = b""
+        while len(data) < count:
+            more = self.process.stdout.read(count - len(data))
+            if not more:
+                raise RemoteError("the program ended")
+            data += more
+        return data
+
+    def close(self):
+        self.process.stdin.close()
+        self.process.wait()
+
+
+class SerialLink:
+    def __init__(self, device):
+        import serial
+        self.port = serial.Serial(device, 19200, timeout=30)
+
+    def write(self, data):
+        self.port.write(data)
+
+    def read(self, count):
+        data = self.port.read(count)
+        if len(data) < count:
+            raise RemoteError("no reply from the board")
+        return data
+
+    def close(self):
+        self.port.close()
+
+
+class Remote:
+    def __init__(self, link):
+        self.link = link
+        # the start screen may still be being drawn, so skip to the hello
+        link.write(bytes([ENQ]))
+        while link.read(1)[0] != SOF:
+            pass
+        kind, payload = self.read_frame(skip_start=True)
+        if kind != HELLO | REPLY:
+            raise RemoteError("no hello from the board")
+        self.version = payload[0]
+
+    def read_frame(self, skip_start=False):
+        if not skip_start and self.link.read(1)[0] != SOF:
+            raise RemoteError("reply doesn't start with SOF")
+        length, kind = self.link.read(2)
+        payload = self.link.read(length)
+        crc = struct.unpack(">H", self.link.read(2))[0]
+        if crc != binascii.crc_hqx(bytes([length, kind]) + payload, 0):
+            raise RemoteError("reply has a bad CRC")
+        return kind, payload
+
+    def command(self, kind, payload=b""):
+        body = bytes([len(payload), kind]) + payload
+        crc = binascii.crc_hqx(body, 0)
+        self.link.write(bytes([SOF]) + body + struct.pack(">H", crc))
+        reply, reply_payload = self.read_frame()
+        if reply == ERROR:
+            raise RemoteError("%s (command %d)" % (
+                ERRORS.get(reply_payload[1], reply_payload[1]), reply_payload[0]))
+        if reply != kind | REPLY:
+            raise RemoteError("reply %#x to command %#x" % (reply, kind))
+        return reply_payload
+
+    @staticmethod
+    def position(payload):
+        pieces1, pieces2, side, over = struct.unpack("<QQBB", payload)
+        return (pieces1, pieces2), side, bool(over)
+
+    def new_game(self):
+        return self.position(self.command(NEW_GAME))
+
+    def place(self, square):
+        return self.position(self.command(PLACE, bytes([square])))
+
+    def legal_moves(self):
+        return struct.unpack("<Q", self.command(GET_MOVES))[0]
+
+    def get_position(self):
+        return self.position(self.command(GET_POSITION))
+
+    def stats(self):
+        return struct.unpack("<5H", self.command(GET_STATS))
+
+    def computer_move(self, time_ms):
+        move, depth, solved, score, nodes, ms = struct.unpack(
+            "<BBBhII", self.command(COMPUTER_MOVE, struct.pack("<H", time_ms)))
+        return move, depth, nodes, ms
+
+    def exit(self):
+        self.command(EXIT)
+
+
+def squares(bits):
+    return [sq for sq in range(64) if bits >> sq & 1]
+
+
+def play_game(remote, time_ms, rng):
+    pieces, side, over = remote.new_game()
+    if pieces != (0x0000001008000000, 0x0000000810000000) or side != 0:
+        raise RemoteError("unexpected starting position")
+    # the board plays the second player
+    while not over:
+        if side == 0:
+            moves = squares(remote.legal_moves())
+            pieces, side, over = remote.place(rng.choice(moves))
+        else:
+            remote.computer_move(time_ms)
+            pieces, side, over = remote.get_position()
+        if pieces[0] & pieces[1]:
+            raise RemoteError("a square is held by both players")
+    return bin(pieces[0]).count("1"), bin(pieces[1]).count("1")
+
+
+def main():
+    args = sys.argv[1:]
+    if not args:
+        print(__doc__.strip().split("Usage:")[1], file=sys.stderr)
+        sys.exit(2)
+    if args[0] == "--exec":
+        link = PipeLink(args[1])
+        args = args[2:]
+    else:
+        link = SerialLink(args[0])
+        args = args[1:]
+    games = int(args[0]) if args else 1
+    time_ms = int(args[1]) if len(args) > 1 else 100
+
+    rng = random.Random(1)
+    remote = Remote(link)
+    start = time.monotonic()
+    for game in range(games):
+        random_side, board_side = play_game(remote, time_ms, rng)
+        print("game %d: random %d, board %d" % (game + 1, random_side, board_side))
+    frames, crc_errors, bad_frames, overruns, dropped = remote.stats()
+    print("%d frames in %.1f s, %d bad CRCs, %d bad frames, %d overruns, %d dropped"
+          % (frames, time.monotonic() - start, crc_errors, bad_frames, overruns, dropped))
+    remote.exit()
+    link.close()
+
+
+if __name__ == "__main__":
+    main()
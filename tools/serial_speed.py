@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+serial_speed.py
+
+Moves the board to a faster baud rate, or measures how fast each rate is.
+Needs pyserial. The board must be showing the start screen, which is where
+it listens for requests (see baud.h for the exchange):
+
+    computer: SYN "B<rate>" CR
+    board:    SYN "ACK <rate>" CR LF, or SYN "NAK" CR LF
+    both change to the new rate
+    computer: SYN "OK" CR
+    board:    SYN "OK" CR LF
+
+If the board doesn't hear the OK within a second it goes back to the rate
+it had, so a rate the cable or adapter can't manage does no harm.
+
+Usage:
+    python3 tools/serial_speed.py PORT RATE     switch to RATE and stay there
+    python3 tools/serial_speed.py PORT          try each rate, run the serial
+                                                benchmark ('t') at it and go
+                                                back to 19200
+"""
+
+import sys
+import time
+
+import serial
+
+SYN = b"\x16"
+START_BAUD = 19200
+RATES = [38400, 57600, 76800, 115200, 250000, 500000, 1000000]
+
+# how long the board may take to answer (seconds), it gives up waiting for
+# the OK after 1
+REPLY_TIMEOUT = 0.5
+
+
+def read_reply(port):
+    """Read a reply line from the board, skipping anything before the SYN."""
+    line = port.read_until(b"\n")
+    start = line.rfind(SYN)
+    if start < 0:
+        return None
+    return line[start + 1:].strip().decode("ascii", "replace")
+
+
+def negotiate(port, rate):
+    """Ask the board for 'rate'. Returns True if both ends are now at it,
+    False if they are still at the old rate."""
+    port.reset_input_buffer()
+    port.write(SYN + b"B%d\r" % rate)
+    reply = read_reply(port)
+    if reply != "ACK %d" % rate:
+        return False
+    # the ACK has arrived, so the board has finished sending at the old rate
+    port.baudrate = rate
+    time.sleep(0.01)
+    port.reset_input_buffer()
+    port.write(SYN + b"OK\r")
+    if read_reply(port) == "OK":
+        return True
+    # the board will go back to the old rate by itself
+    time.sleep(1.0)
+    return False
+
+
+def run_benchmark(port):
+    """Run the serial benchmark and return its result line, along with the
+    bytes per second measured at this end."""
+    port.reset_input_buffer()
+    port.write(b"t")
+    received = 0
+    start = None
+    result = None
+    while True:
+        line = port.readline()
+        if not line:
+            break
+        if line.startswith(b"0123456789"):
+            if start is None:
+                start = time.monotonic()
+            received += len(line)
+            end = time.monotonic()
+        elif b"bytes/s" in line:
+            result = line.strip().decode("ascii", "replace")
+            break
+    measured = received / (end - start) if start is not None and end > start else 0
+    return result, measured
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        print(__doc__.strip().split("Usage:")[1], file=sys.stderr)
+        sys.exit(2)
+
+    port = serial.Serial(sys.argv[1], START_BAUD, timeout=REPLY_TIMEOUT)
+    if len(sys.argv) == 3:
+        rate = int(sys.argv[2])
+        if not negotiate(port, rate):
+            sys.exit("the board stayed at %d baud" % port.baudrate)
+        print("now at %d baud" % rate)
+        return
+
+    for rate in RATES:
+        port.timeout = REPLY_TIMEOUT
+        if not negotiate(port, rate):
+            print("%8d  not used" % rate)
+            continue
+        port.timeout = 5
+        result, measured = run_benchmark(port)
+        print("%8d  %s (%d bytes/s received here)" % (rate, result, measured))
+        port.timeout = REPLY_TIMEOUT
+        if not negotiate(port, START_BAUD):
+            sys.exit("couldn't go back to %d baud" % START_BAUD)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,105 @@
+/*
+ * ttable.c
+ *
+ * Transposition table for the computer player's search.
+ *
+ * The table is split into buckets of two entries. The first entry of a
+ * bucket keeps the most expensive result (the deepest search) from the
+ * current search, the second is always replaced. With the few dozen
+ * entries that fit on the AVR the deep results near the root would be
+ * overwritten almost at once by the flood of shallow ones if every store
+ * replaced what was there, the second entry gives the shallow results
+ * somewhere to go instead.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ttable.h"
+
+#define TT_BUCKETS (TT_ENTRIES / 2)
+#define TT_AGE_SHIFT 2
+
+static ENGINE_TLS tt_entry_t table[TT_ENTRIES];
+static ENGINE_TLS tt_stats_t stats;
+
+// entries stored by the current search are marked with this
+static ENGINE_TLS uint8_t age;
+
+static ENGINE_TLS uint8_t enabled = 1;
+
+void tt_clear(void) {
+	// entries with a depth of 0 are empty, nothing is ever stored at depth 0
+	memset(table, 0, sizeof(table));
+	memset(&stats, 0, sizeof(stats));
+	age = 0;
+}
+
+void tt_new_search(void) {
+	age = (age + 1) & (0xFF >> TT_AGE_SHIFT);
+}
+
+void tt_set_enabled(uint8_t on) {
+	enabled = on;
+}
+
+static inline tt_entry_t *bucket_of(zobrist_t hash) {
+	return &table[2 * (hash & (TT_BUCKETS - 1))];
+}
+
+static inline uint8_t entry_age(const tt_entry_t *entry) {
+	return entry->flags >> TT_AGE_SHIFT;
+}
+
+const tt_entry_t *tt_probe(zobrist_t hash) {
+	if (!enabled) {
+		return 0;
+	}
+	tt_entry_t *bucket = bucket_of(hash);
+	tt_check_t check = TT_CHECK(hash);
+	stats.probes++;
+	for (uint8_t i = 0; i < 2; i++) {
+		if (bucket[i].check == check && bucket[i].depth != 0) {
+			stats.hits++;
+			return &bucket[i];
+		}
+	}
+	return 0;
+}
+
+void tt_store(zobrist_t hash, uint8_t depth, int16_t score, uint8_t bound,
+		uint8_t move) {
+	if (!enabled) {
+		return;
+	}
+	tt_entry_t *bucket = bucket_of(hash);
+	tt_check_t check = TT_CHECK(hash);
+	tt_entry_t *entry;
+
+	if (bucket[0].check == check) {
+		// the position is already in the deep slot, refresh it there
+		entry = &bucket[0];
+	} else if (entry_age(&bucket[0]) != age || depth >= bucket[0].depth) {
+		// the deep slot holds something older or shallower, move that
+		// to the other slot rather than throwing it away
+		bucket[1] = bucket[0];
+		entry = &bucket[0];
+	} else {
+		entry = &bucket[1];
+	}
+
+	entry->check = check;
+	entry->score = score;
+	entry->move = move;
+	entry->depth = depth;
+	entry->flags = bound | (age << TT_AGE_SHIFT);
+	stats.stores++;
+}
+
+void tt_count_cutoff(void) {
+	stats.cutoffs++;
+}
+
+const tt_stats_t *tt_get_stats(void) {
+	return &stats;
+}
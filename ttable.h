@@ -0,0 +1,91 @@
+/*
+ * ttable.h
+ *
+ * Transposition table for the computer player's search. Results of
+ * searched positions are stored by Zobrist hash so that a position
+ * reached again through a different order of moves does not have to be
+ * searched again.
+ *
+ * The table holds (1 << TT_SIZE_LOG2) entries. The default is tiny on
+ * the AVR (a few hundred bytes of SRAM) and a few megabytes elsewhere,
+ * define TT_SIZE_LOG2 when compiling to choose another size.
+ */
+
+#ifndef TTABLE_H_
+#define TTABLE_H_
+
+#include <stdint.h>
+
+#include "game.h"
+
+#ifndef TT_SIZE_LOG2
+#ifdef __AVR__
+#define TT_SIZE_LOG2 5
+#else
+#define TT_SIZE_LOG2 20
+#endif
+#endif
+
+#define TT_ENTRIES (1UL << TT_SIZE_LOG2)
+
+// what the stored score means
+#define TT_EXACT	0	// the score is exact
+#define TT_LOWER	1	// the true score is at least this (a beta cut-off)
+#define TT_UPPER	2	// the true score is at most this (no move beat alpha)
+
+// part of the hash kept in each entry to tell positions apart, the rest
+// of the hash is used to choose where the entry goes
+#ifdef __AVR__
+typedef uint16_t tt_check_t;
+#define TT_CHECK(hash) ((tt_check_t)((hash) >> 16))
+#else
+typedef uint32_t tt_check_t;
+#define TT_CHECK(hash) ((tt_check_t)((hash) >> 32))
+#endif
+
+typedef struct {
+	tt_check_t check;
+	int16_t score;
+	uint8_t move;		// best move found, or NO_TT_MOVE
+	uint8_t depth;		// depth the position was searched to
+	uint8_t flags;		// bound type in the low 2 bits, search age above
+} tt_entry_t;
+
+#define NO_TT_MOVE 0xFF
+
+// the kind of bound stored in an entry
+#define TT_BOUND(entry) ((entry)->flags & 0x03)
+
+// counters which show how well the table is working
+typedef struct {
+	uint32_t probes;	// lookups
+	uint32_t hits;		// lookups which found the position
+	uint32_t cutoffs;	// hits which ended the search of that position
+	uint32_t stores;
+} tt_stats_t;
+
+// empty the table and reset the counters
+void tt_clear(void);
+
+// start a new search, entries from older searches are then the first to
+// be replaced
+void tt_new_search(void);
+
+// turn the table off (0) or on again (1). While it is off nothing is
+// looked up or stored, so a search can be compared with and without it
+void tt_set_enabled(uint8_t enabled);
+
+// look up a position, returns the entry or 0 if it is not in the table
+const tt_entry_t *tt_probe(zobrist_t hash);
+
+// store the result of searching a position
+void tt_store(zobrist_t hash, uint8_t depth, int16_t score, uint8_t bound,
+		uint8_t move);
+
+// record that a probe allowed the search of a position to be skipped
+void tt_count_cutoff(void);
+
+// returns the counters since the last tt_clear()
+const tt_stats_t *tt_get_stats(void);
+
+#endif /* TTABLE_H_ */